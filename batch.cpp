@@ -0,0 +1,319 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <iomanip>
+#include "generator/forest.h"
+#include "generator/tree_file.h"
+#include "generator/mesh_export.h"
+#include "generator/profiler.h"
+
+using namespace std;
+using namespace glm;
+
+// One set of generation parameters. ri, dk and error are multipliers for dp, the same as when entered in the viewer
+struct job
+{
+	uint32_t no_points = 3000;
+	float dp = 0.1f;
+	float ri = 10.0f;
+	float dk = 1.6f;
+	float error = 0.1f;
+	tropisms tropism = none;
+	vector<vec2> envelope_curve = default_envelope_curve();
+	uint64_t seed = 0;
+	int count = 1;
+};
+
+void print_usage()
+{
+	cout << "Usage: TreeBatch [options]" << endl;
+	cout << "  --points N       Number of attraction points (default 3000)" << endl;
+	cout << "  --dp D           Node placement distance (default 0.1)" << endl;
+	cout << "  --ri R           Radius of influence as a multiplier for dp (default 10)" << endl;
+	cout << "  --dk K           Kill distance as a multiplier for dp (default 1.6)" << endl;
+	cout << "  --error E        Furthest simplification may move the skeleton as a multiplier for dp (default 0.1)" << endl;
+	cout << "  --tropism T      none, gravity, wind, attract or spin (default none)" << endl;
+	cout << "  --envelope FILE  Envelope curve with one \"radius height\" pair per line, top to bottom" << endl;
+	cout << "  --seed S         64-bit seed of the first tree (default 0)" << endl;
+	cout << "  --count N        Number of trees to generate, seeded S, S + 1, ... (default 1)" << endl;
+	cout << "  --job FILE       Run one batch per line of FILE. Lines hold the options above and override the command line" << endl;
+	cout << "  --out DIR        Write every tree into DIR as an OBJ file of line segments" << endl;
+	cout << "  --threads N      Number of trees grown at once, 0 for one per core (default 0)" << endl;
+	cout << "  --forest FILE    Write every tree with its branch radii into one tree file" << endl;
+	cout << "  --mesh FILE      Export the bodies of every tree in the --forest file as one binary .ply or .glb mesh" << endl;
+	cout << "  --cache DIR      Load trees grown before from DIR and store new ones there" << endl;
+	cout << "  --profile NAME   Write a Chrome trace to NAME.json and per-pass totals to NAME.csv. Passes of trees grown at once share rows" << endl;
+}
+
+// Reads an envelope curve file. Returns false if the curve is unusable
+bool load_envelope(const string &file, vector<vec2> &curve)
+{
+	ifstream in(file);
+	if (!in)
+		return false;
+	curve.clear();
+	vec2 p;
+	while (in >> p.x >> p.y)
+	{
+		if (p.x < 0.0f || p.y < 0.0f || (curve.size() > 0 && p.y > curve[curve.size() - 1].y))
+			return false;
+		curve.push_back(p);
+	}
+	return curve.size() >= 2;
+}
+
+// Applies a single option to a job. Returns false if the option or its value is invalid
+bool parse_option(const string &flag, const string &value, job &j)
+{
+	try
+	{
+		if (flag == "--points")
+			j.no_points = stoul(value);
+		else if (flag == "--dp")
+			j.dp = stof(value);
+		else if (flag == "--ri")
+			j.ri = stof(value);
+		else if (flag == "--dk")
+			j.dk = stof(value);
+		else if (flag == "--error")
+			j.error = stof(value);
+		else if (flag == "--seed")
+			j.seed = stoull(value);
+		else if (flag == "--count")
+			j.count = stoi(value);
+		else if (flag == "--tropism")
+		{
+			const string names[] = { "none", "gravity", "wind", "attract", "spin" };
+			int t = 0;
+			while (t < 5 && names[t] != value)
+				t++;
+			if (t == 5)
+				return false;
+			j.tropism = tropisms(t);
+		}
+		else if (flag == "--envelope")
+			return load_envelope(value, j.envelope_curve);
+		else
+			return false;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+	return true;
+}
+
+// Checks the same ranges as the viewer, except that there is no upper limit on the number of points
+bool valid(const job &j)
+{
+	return j.no_points >= 1 && j.dp > 0.01f && j.dp <= 10.0f && j.ri > 1.5f && j.ri <= 100.0f && j.dk > 1.5f && j.dk <= 100.0f && j.dk <= j.ri && j.error >= 0.0f && j.error <= 10.0f && j.count >= 1;
+}
+
+// Writes the live nodes of a tree as OBJ vertices joined by line elements
+bool write_obj(const string &file, const node_tree &nodes)
+{
+	ofstream out(file);
+	if (!out)
+		return false;
+	vector<int> index(nodes.ids(), 0);
+	int n = 0;
+	for (int id = 0; id < nodes.ids(); id++)
+		if (!nodes.removed[id])
+		{
+			index[id] = ++n;
+			out << "v " << nodes.pos[id].x << " " << nodes.pos[id].y << " " << nodes.pos[id].z << "\n";
+		}
+	for (int id = 1; id < nodes.ids(); id++)
+		if (!nodes.removed[id])
+			out << "l " << index[nodes.parent[id]] << " " << index[id] << "\n";
+	return bool(out);
+}
+
+// Makes the parameters of a job's trees
+tree_parameters to_parameters(const job &j)
+{
+	tree_parameters params;
+	params.no_points = j.no_points;
+	params.dp = j.dp;
+	params.ri = j.ri * j.dp;
+	params.dk = j.dk * j.dp;
+	params.max_error = j.error * j.dp;
+	params.tropism = j.tropism;
+	params.envelope_curve = j.envelope_curve;
+	return params;
+}
+
+int main(int argc, char *argv[])
+{
+	job defaults;
+	string job_file = "";
+	string out_dir = "";
+	string cache_dir = "";
+	string forest_file = "";
+	string mesh_file = "";
+	string profile = "";
+	int threads = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		string flag = argv[i];
+		if (flag == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		if (i + 1 >= argc)
+		{
+			cerr << "Missing value for " << flag << endl;
+			return 1;
+		}
+		string value = argv[++i];
+		if (flag == "--job")
+			job_file = value;
+		else if (flag == "--out")
+			out_dir = value;
+		else if (flag == "--cache")
+			cache_dir = value;
+		else if (flag == "--forest")
+			forest_file = value;
+		else if (flag == "--mesh")
+			mesh_file = value;
+		else if (flag == "--profile")
+			profile = value;
+		else if (flag == "--threads")
+		{
+			try
+			{
+				threads = stoi(value);
+			}
+			catch (const std::exception&)
+			{
+				threads = -1;
+			}
+			if (threads < 0)
+			{
+				cerr << "Invalid option " << flag << " " << value << endl;
+				return 1;
+			}
+		}
+		else if (!parse_option(flag, value, defaults))
+		{
+			cerr << "Invalid option " << flag << " " << value << endl;
+			return 1;
+		}
+	}
+
+	string mesh_type = mesh_file.size() > 4 ? mesh_file.substr(mesh_file.size() - 4) : "";
+	if (mesh_file != "" && (forest_file == "" || (mesh_type != ".ply" && mesh_type != ".glb")))
+	{
+		cerr << "--mesh needs a .ply or .glb file name and a --forest file to read the trees from" << endl;
+		return 1;
+	}
+
+	vector<job> jobs;
+	if (job_file == "")
+		jobs.push_back(defaults);
+	else
+	{
+		ifstream in(job_file);
+		if (!in)
+		{
+			cerr << "Could not open job file " << job_file << endl;
+			return 1;
+		}
+		string line;
+		for (int line_no = 1; getline(in, line); line_no++)
+		{
+			istringstream words(line);
+			string flag, value;
+			if (!(words >> flag) || flag[0] == '#')
+				continue;
+			job j = defaults;
+			do
+			{
+				if (!(words >> value) || !parse_option(flag, value, j))
+				{
+					cerr << job_file << ":" << line_no << ": invalid option " << flag << endl;
+					return 1;
+				}
+			} while (words >> flag);
+			jobs.push_back(j);
+		}
+	}
+
+	for (const job &j : jobs)
+		if (!valid(j))
+		{
+			cerr << "Parameters out of range, see --help for the accepted values" << endl;
+			return 1;
+		}
+
+	vector<forest_job> forest;
+	for (const job &j : jobs)
+		for (int i = 0; i < j.count; i++)
+		{
+			forest_job f;
+			f.params = to_parameters(j);
+			f.seed = j.seed + i;
+			forest.push_back(f);
+		}
+
+	tree_file_writer writer;
+	if (forest_file != "" && !writer.open(forest_file))
+	{
+		cerr << "Could not create " << forest_file << endl;
+		return 1;
+	}
+	tree_cache cache(cache_dir);
+	if (profile != "")
+		profiler::enable(true);
+	bool ok = grow_forest(forest, threads, [&](const forest_tree &tree)
+	{
+		cout << "[" << tree.done << "/" << tree.total << "] tree " << tree.index << ": seed " << tree.job->seed << ", " << tree.nodes->size() << " nodes, checksum " << hex << setw(16) << setfill('0') << tree.nodes->checksum() << dec << setfill(' ') << ", " << int(tree.ms) << " ms" << (tree.cached ? " (cached)" : "") << endl;
+		if (out_dir != "" && !write_obj(out_dir + "/tree_" + to_string(tree.index) + ".obj", *tree.nodes))
+		{
+			cerr << "Could not write tree " << tree.index << " to " << out_dir << endl;
+			return false;
+		}
+		// Trees are written in the order they finish. The keys let readers match them back to their parameters and seed
+		if (forest_file != "" && !writer.add(*tree.nodes, *tree.radii, tree_key(tree.job->params, tree.job->seed)))
+		{
+			cerr << "Could not write tree " << tree.index << " to " << forest_file << endl;
+			return false;
+		}
+		return true;
+	}, cache_dir != "" ? &cache : nullptr);
+	if (forest_file != "" && !writer.close())
+	{
+		cerr << "Could not write " << forest_file << endl;
+		return 1;
+	}
+
+	// The bodies are built from the mapped forest file a chunk at a time, so the whole mesh is never in memory
+	if (ok && mesh_file != "")
+	{
+		tree_file file;
+		if (!file.open(forest_file))
+		{
+			cerr << "Could not read " << forest_file << endl;
+			return 1;
+		}
+		body_chunks chunks(file.trees, 10);
+		mesh_chunks fill = [&chunks](int c, mesh_data &m) { chunks.fill(c, m); };
+		if (!(mesh_type == ".ply" ? export_ply(mesh_file, chunks.count(), fill) : export_glb(mesh_file, chunks.count(), fill)))
+		{
+			cerr << "Could not export " << mesh_file << endl;
+			return 1;
+		}
+	}
+	if (profile != "")
+	{
+		profiler::enable(false);
+		if (!profiler::write_trace(profile + ".json") || !profiler::write_csv(profile + ".csv"))
+		{
+			cerr << "Could not write the profile " << profile << endl;
+			return 1;
+		}
+	}
+	return ok ? 0 : 1;
+}
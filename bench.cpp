@@ -0,0 +1,276 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "generator/tree_generator.h"
+#include "generator/mesh_data.h"
+#include "generator/profiler.h"
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+// Every heap allocation of the process is counted, so the generator's allocations can be checked over many trees
+static std::atomic<uint64_t> allocations(0);
+
+void *operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void *p = malloc(size > 0 ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+// Fixed input of one benchmark run. Every scenario uses the same seed so runs can be compared between builds
+struct scenario
+{
+	string name;
+	tree_parameters params;
+};
+
+// Highest memory use of the process so far in kilobytes, 0 if unknown
+long peak_rss_kb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return long(counters.PeakWorkingSetSize / 1024);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Tall and thin, so most of the growth is a single trunk
+vector<vec2> narrow_envelope_curve()
+{
+	vector<vec2> curve;
+	curve.push_back(vec2(0.0f, 10.0f));
+	curve.push_back(vec2(0.4f, 9.5f));
+	curve.push_back(vec2(0.5f, 6.0f));
+	curve.push_back(vec2(0.4f, 2.0f));
+	curve.push_back(vec2(0.0f, 1.5f));
+	return curve;
+}
+
+vector<scenario> make_scenarios()
+{
+	vector<scenario> list;
+	const uint32_t sizes[] = { 1000, 3000, 10000, 100000 };
+	for (uint32_t n : sizes)
+	{
+		scenario s;
+		s.name = "default_" + to_string(n);
+		s.params.no_points = n;
+		list.push_back(s);
+	}
+	const string names[] = { "none", "gravity", "wind", "attract", "spin" };
+	for (int t = 1; t < 5; t++)
+	{
+		scenario s;
+		s.name = names[t] + "_3000";
+		s.params.tropism = tropisms(t);
+		list.push_back(s);
+	}
+	scenario s;
+	s.name = "narrow_3000";
+	s.params.envelope_curve = narrow_envelope_curve();
+	list.push_back(s);
+	return list;
+}
+
+void print_usage()
+{
+	cout << "Usage: TreeBench [options]" << endl;
+	cout << "  --scenario NAME  Only run scenarios whose name contains NAME" << endl;
+	cout << "  --repeat N       Run every scenario N times and report the fastest (default 1)" << endl;
+	cout << "  --max-passes N   Stop growing after N passes, as some tropisms never finish (default 300)" << endl;
+	cout << "  --threads N      Threads used by each tree, 0 for every core (default 0)" << endl;
+	cout << "  --seed S         Seed of every scenario (default 1)" << endl;
+	cout << "  --generations N  Grow every scenario N times with seeds S, S + 1, ... on one generator and report its allocations" << endl;
+	cout << "  --profile NAME   Write a Chrome trace to NAME.json and per-pass totals to NAME.csv" << endl;
+	cout << "  --list           Print the scenario names and exit" << endl;
+}
+
+// Times of one run in milliseconds
+struct run_result
+{
+	phase_times times;
+	double body = 0.0;
+	double total = 0.0;
+	int nodes = 0;
+	uint64_t allocations = 0; // Heap allocations while growing and simplifying
+};
+
+run_result run(tree_generator &generator, uint64_t seed, int max_passes)
+{
+	run_result r;
+	auto begin = chrono::steady_clock::now();
+	uint64_t first_allocation = allocations;
+	generator.start(seed);
+	while (!generator.finished && generator.points.size() > 0 && generator.times.passes < max_passes)
+		generator.single_pass();
+	generator.simplify();
+	r.allocations = allocations - first_allocation;
+	auto body_begin = chrono::steady_clock::now();
+	mesh_data body = body_mesh(generator.nodes, generator.nodes.pipe_radii(), 8);
+	auto end = chrono::steady_clock::now();
+	r.times = generator.times;
+	r.body = chrono::duration<double, milli>(end - body_begin).count();
+	r.total = chrono::duration<double, milli>(end - begin).count();
+	r.nodes = generator.nodes.size();
+	return r;
+}
+
+int main(int argc, char *argv[])
+{
+	string filter = "";
+	int repeat = 1;
+	int max_passes = 300;
+	int threads = 0;
+	uint64_t seed = 1;
+	string profile = "";
+	int generations = 0;
+	vector<scenario> scenarios = make_scenarios();
+	for (int i = 1; i < argc; i++)
+	{
+		string flag = argv[i];
+		if (flag == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		if (flag == "--list")
+		{
+			for (const scenario &s : scenarios)
+				cout << s.name << endl;
+			return 0;
+		}
+		if (i + 1 >= argc)
+		{
+			cerr << "Missing value for " << flag << endl;
+			return 1;
+		}
+		string value = argv[++i];
+		try
+		{
+			if (flag == "--scenario")
+				filter = value;
+			else if (flag == "--repeat")
+				repeat = stoi(value);
+			else if (flag == "--max-passes")
+				max_passes = stoi(value);
+			else if (flag == "--threads")
+				threads = stoi(value);
+			else if (flag == "--seed")
+				seed = stoull(value);
+			else if (flag == "--generations")
+				generations = stoi(value);
+			else if (flag == "--profile")
+				profile = value;
+			else
+				repeat = 0;
+		}
+		catch (const std::exception&)
+		{
+			repeat = 0;
+		}
+		if (repeat < 1 || max_passes < 1 || threads < 0 || generations < 0)
+		{
+			cerr << "Invalid option " << flag << " " << value << endl;
+			return 1;
+		}
+	}
+
+	// Timers cost a little, so the times of a profiled run are not comparable with an unprofiled one
+	if (profile != "")
+		profiler::enable(true);
+	bool any = false;
+	if (generations > 0)
+	{
+		// Growth should stop allocating once the generator has held its largest tree
+		cout << left << setw(16) << "scenario" << right << setw(12) << "first" << setw(12) << "last" << setw(12) << "max" << setw(14) << "storage KB" << setw(12) << "peak KB" << endl;
+		for (const scenario &s : scenarios)
+		{
+			if (s.name.find(filter) == string::npos)
+				continue;
+			any = true;
+			tree_generator generator(s.params);
+			generator.params.threads = threads;
+			uint64_t first = 0, last = 0, most = 0;
+			for (int g = 0; g < generations; g++)
+			{
+				last = run(generator, seed + g, max_passes).allocations;
+				if (g == 0)
+					first = last;
+				most = std::max(most, last);
+			}
+			cout << left << setw(16) << s.name << right << setw(12) << first << setw(12) << last << setw(12) << most << setw(14) << generator.storage_bytes() / 1024 << setw(12) << peak_rss_kb() << endl;
+		}
+	}
+	else
+	{
+		cout << left << setw(16) << "scenario" << right << setw(8) << "passes" << setw(9) << "nodes" << setw(10) << "sample" << setw(10) << "attract" << setw(10) << "colonise" << setw(10) << "purge" << setw(10) << "simplify" << setw(10) << "body" << setw(10) << "total" << setw(12) << "nodes/s" << setw(10) << "allocs" << setw(12) << "peak KB" << endl;
+		cout << fixed << setprecision(1);
+		for (const scenario &s : scenarios)
+		{
+			if (s.name.find(filter) == string::npos)
+				continue;
+			any = true;
+			// The fastest run is the one least disturbed by the rest of the system
+			run_result best;
+			for (int r = 0; r < repeat; r++)
+			{
+				tree_generator generator(s.params);
+				generator.params.threads = threads;
+				run_result result = run(generator, seed, max_passes);
+				if (r == 0 || result.total < best.total)
+					best = result;
+			}
+			const phase_times &t = best.times;
+			cout << left << setw(16) << s.name << right << setw(8) << t.passes << setw(9) << best.nodes << setw(10) << t.sample << setw(10) << t.attract << setw(10) << t.colonise << setw(10) << t.purge << setw(10) << t.simplify << setw(10) << best.body << setw(10) << best.total << setw(12) << setprecision(0) << best.nodes / (best.total / 1000.0) << setw(10) << best.allocations << setprecision(1) << setw(12) << peak_rss_kb() << endl;
+		}
+	}
+	if (!any)
+	{
+		cerr << "No scenario matches " << filter << ", see --list" << endl;
+		return 1;
+	}
+	if (profile != "")
+	{
+		profiler::enable(false);
+		if (!profiler::write_trace(profile + ".json") || !profiler::write_csv(profile + ".csv"))
+		{
+			cerr << "Could not write the profile " << profile << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
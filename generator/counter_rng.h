@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+// Counter based random numbers. The n-th number of a stream is splitmix64's finaliser applied to key + (n + 1) * 0x9E3779B97F4A7C15,
+// where key mixes the seed with the stream number. Each number depends only on (seed, stream, n), so streams can be drawn
+// on any thread in any order and always give the same values
+struct counter_rng
+{
+	uint64_t key;
+	uint64_t counter = 0;
+
+	counter_rng(uint64_t seed, uint64_t stream)
+	{
+		key = mix(seed ^ mix(stream + 0x9E3779B97F4A7C15ull));
+	}
+
+	// Returns the next 64 random bits of the stream
+	uint64_t next()
+	{
+		return mix(key + ++counter * 0x9E3779B97F4A7C15ull);
+	}
+
+	// Returns a float in [0, 1) made from the top 24 bits of the next number
+	float uniform()
+	{
+		return (next() >> 40) * (1.0f / 16777216.0f);
+	}
+
+	// splitmix64's finaliser
+	static uint64_t mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
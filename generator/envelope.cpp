@@ -0,0 +1,204 @@
+#include "envelope.h"
+#include "counter_rng.h"
+#include "parallel.h"
+#include <lib/glm/glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+vector<vec2> default_envelope_curve()
+{
+	vector<vec2> curve;
+	curve.push_back(vec2(0.0f, 8.0f));
+	curve.push_back(vec2(0.6f, 7.8f));
+	curve.push_back(vec2(1.2f, 7.4f));
+	curve.push_back(vec2(1.8f, 6.9f));
+	curve.push_back(vec2(2.2f, 6.2f));
+	curve.push_back(vec2(2.5f, 5.3f));
+	curve.push_back(vec2(2.4f, 4.5f));
+	curve.push_back(vec2(2.0f, 4.0f));
+	curve.push_back(vec2(1.7f, 3.5f));
+	curve.push_back(vec2(1.3f, 3.0f));
+	curve.push_back(vec2(0.9f, 2.5f));
+	return curve;
+}
+
+vector<pair<vec3, vec3>> curve_to_segments(const vector<vec2> &v)
+{
+	int count = v.size();
+	vector<pair<vec3, vec3>> seg;
+	if (count < 1)
+		return seg;
+	seg.push_back(pair<vec3, vec3>(vec3(0.0f, v[0].y, 0.0f), vec3(v[0].x, v[0].y, 0.0f)));
+	if (count == 1)
+		return seg;
+	for (int i = 0; i < count - 1; i++)
+	{
+		seg.push_back(pair<vec3, vec3>(vec3(v[i].x, v[i].y, 0.0f), vec3(v[i + 1].x, v[i + 1].y, 0.0f)));
+	}
+
+	seg.push_back(pair<vec3, vec3>(vec3(0.0f, v[count - 1].y, 0.0f), vec3(v[count - 1].x, v[count - 1].y, 0.0f)));
+	seg.push_back(pair<vec3, vec3>(seg[0].first, seg[seg.size() - 1].first));
+	return seg;
+}
+
+bool inside_rotated_curve(const vec3 &point, const vector<vec2> &curve)
+{
+	// Check if above below curve
+	if (point.y > curve[0].y)
+		return false;
+	if (point.y < curve[curve.size() - 1].y)
+		return false;
+
+	for (int i = 0; i < curve.size() - 1; i++)
+		if (point.y >= curve[i + 1].y)
+		{
+			float d2 = (point.x * point.x) + (point.z * point.z);
+			float alpha = (curve[i].y - point.y) / (curve[i].y - curve[i + 1].y);
+			float cd = (curve[i + 1].x - curve[i].x) * alpha + curve[i].x;
+			if (d2 > cd * cd)
+				return false;
+			else
+				return true;
+		}
+	return false;
+}
+
+compiled_envelope::compiled_envelope(const vector<vec2> &curve)
+{
+	if (curve.size() < 2)
+		return;
+	for (int i = curve.size() - 1; i >= 0; i--)
+		heights.push_back(curve[i].y);
+	for (int i = curve.size() - 1; i > 0; i--)
+	{
+		vec2 bottom = curve[i];
+		vec2 top = curve[i - 1];
+		// A flat step has no height of its own, so it takes the wider radius
+		float s = top.y > bottom.y ? (top.x - bottom.x) / (top.y - bottom.y) : 0.0f;
+		slope.push_back(s);
+		intercept.push_back(top.y > bottom.y ? bottom.x - s * bottom.y : glm::max(top.x, bottom.x));
+	}
+	// Aim for buckets no taller than the shortest segment, ignoring flat steps, within a limit on the size of the table
+	float range = heights[heights.size() - 1] - heights[0];
+	float shortest = range;
+	for (int i = 0; i + 1 < heights.size(); i++)
+		if (heights[i + 1] > heights[i])
+			shortest = glm::min(shortest, heights[i + 1] - heights[i]);
+	int count = range > 0.0f ? glm::min(int(ceil(range / shortest)), 4096) : 1;
+	bucket_scale = range > 0.0f ? count / range : 0.0f;
+	bucket_first.assign(count, int(slope.size()) - 1);
+	bucket_last.assign(count, 0);
+	// Buckets are found the same way for building and testing, so rounding cannot leave a height outside its bucket's range
+	for (int s = 0; s < slope.size(); s++)
+		for (int k = bucket(heights[s]); k <= bucket(heights[s + 1]); k++)
+		{
+			bucket_first[k] = glm::min(bucket_first[k], s);
+			bucket_last[k] = glm::max(bucket_last[k], s);
+		}
+}
+
+int compiled_envelope::segment(float y) const
+{
+	int k = bucket(y);
+	int first = bucket_first[k];
+	int last = bucket_last[k];
+	if (first == last)
+		return first;
+	// The highest segment starting at or below y
+	return upper_bound(heights.begin() + first + 1, heights.begin() + last + 1, y) - heights.begin() - 1;
+}
+
+bool compiled_envelope::contains(const vec3 &point) const
+{
+	if (slope.size() == 0 || point.y < heights[0] || point.y > heights[heights.size() - 1])
+		return false;
+	int s = segment(point.y);
+	float r = slope[s] * point.y + intercept[s];
+	return point.x * point.x + point.z * point.z <= r * r;
+}
+
+void compiled_envelope::contains(const vector<vec3> &points, vector<uint8_t> &inside) const
+{
+	inside.resize(points.size());
+	if (slope.size() == 0)
+	{
+		fill(inside.begin(), inside.end(), 0);
+		return;
+	}
+	const int block = 256;
+	int segments[block];
+	float bottom = heights[0];
+	float top = heights[heights.size() - 1];
+	for (int begin = 0; begin < points.size(); begin += block)
+	{
+		int end = glm::min(begin + block, int(points.size()));
+		// Heights outside the envelope are clamped for the lookup and rejected in the test
+		for (int i = begin; i < end; i++)
+			segments[i - begin] = segment(glm::clamp(points[i].y, bottom, top));
+		for (int i = begin; i < end; i++)
+		{
+			const vec3 &p = points[i];
+			int s = segments[i - begin];
+			float r = slope[s] * p.y + intercept[s];
+			inside[i] = uint8_t((p.y >= bottom) & (p.y <= top) & (p.x * p.x + p.z * p.z <= r * r));
+		}
+	}
+}
+
+vector<vec3> populate_envelope(const vector<vec2> &curve, uint32_t count, uint64_t seed, int threads)
+{
+	// Cumulative volume of the frustums between consecutive curve points, leaving out the common factor of pi / 3
+	vector<float> volume;
+	float total = 0.0f;
+	for (int i = 0; i + 1 < curve.size(); i++)
+	{
+		float r0 = curve[i].x;
+		float r1 = curve[i + 1].x;
+		total += (curve[i].y - curve[i + 1].y) * (r0 * r0 + r0 * r1 + r1 * r1);
+		volume.push_back(total);
+	}
+	if (total <= 0.0f)
+		return vector<vec3>();
+	vector<vec3> points(count);
+
+	// Every point is placed directly inside the envelope, so none are rejected. Point i only uses stream i of the seed
+	parallel_for(count, threads, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			counter_rng ran(seed, i);
+			// Pick a slice in proportion to its volume
+			int s = upper_bound(volume.begin(), volume.end(), ran.uniform() * total) - volume.begin();
+			s = glm::min(s, int(volume.size()) - 1);
+			float r0 = curve[s].x;
+			float r1 = curve[s + 1].x;
+			float bottom = curve[s + 1].y;
+			float h = curve[s].y - bottom;
+
+			// Pick a height in proportion to the area of the cross section there. The radius grows linearly from the bottom,
+			// so the volume below a height is proportional to r^3 - r1^3, which can be inverted directly
+			float v = ran.uniform();
+			float r;
+			float t;
+			if (fabs(r0 - r1) > 0.001f * glm::max(r0, r1))
+			{
+				r = cbrt(r1 * r1 * r1 + v * (r0 * r0 * r0 - r1 * r1 * r1));
+				t = clamp((r - r1) / (r0 - r1), 0.0f, 1.0f);
+			}
+			else
+			{
+				r = (r0 + r1) / 2.0f;
+				t = v;
+			}
+
+			// Pick a point on the disc at that height, the square root spreads them evenly over its area
+			float d = r * sqrt(ran.uniform());
+			float angle = 2.0f * pi<float>() * ran.uniform();
+			points[i] = vec3(d * cos(angle), bottom + t * h, d * sin(angle));
+		}
+	});
+	return points;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "node_tree.h"
+#include <cstdint>
+#include <algorithm>
+
+// Makes a 2d curve which can later be used to determine if a point is inside the envelope or not. !!Curve should be laid out top to bottom in descending height; all values must be positive!!
+std::vector<glm::vec2> default_envelope_curve();
+
+// Makes a segment vector from envelope curve
+std::vector<std::pair<glm::vec3, glm::vec3>> curve_to_segments(const std::vector<glm::vec2> &v);
+
+// Returns true if a point is inside a rotated curve envelope. The curve is rotated around the y axis
+bool inside_rotated_curve(const glm::vec3 &point, const std::vector<glm::vec2> &curve);
+
+// An envelope curve prepared for repeated containment tests. Heights are split into evenly spaced buckets, each holding the range
+// of curve segments that reach into it, and the segment at a height is found by binary search within its bucket's range. Buckets
+// are no taller than the shortest segment unless that would need more than 4096 of them, so most hold a single segment. The
+// radius at the segment is one multiply-add
+struct compiled_envelope
+{
+	std::vector<float> heights; // Heights of the curve points, bottom to top
+	std::vector<float> slope; // The radius at height y in segment i is slope[i] * y + intercept[i]
+	std::vector<float> intercept;
+	std::vector<int> bucket_first; // Lowest and highest segment reaching into each bucket
+	std::vector<int> bucket_last;
+	float bucket_scale = 0.0f; // Buckets per unit of height
+
+	compiled_envelope() {}
+
+	compiled_envelope(const std::vector<glm::vec2> &curve);
+
+	// Returns true if a point is inside the envelope, the same as inside_rotated_curve
+	bool contains(const glm::vec3 &point) const;
+
+	// Tests every point, setting inside[i] to 1 if points[i] is inside the envelope and 0 otherwise. Points are taken in blocks:
+	// the segments of a whole block are looked up first, and then every point is tested without branches
+	void contains(const std::vector<glm::vec3> &points, std::vector<uint8_t> &inside) const;
+
+private:
+	// Returns the bucket of a height within the envelope
+	int bucket(float y) const
+	{
+		return std::min(int((y - heights[0]) * bucket_scale), int(bucket_first.size()) - 1);
+	}
+
+	// Returns the segment at a height within the envelope
+	int segment(float y) const;
+};
+
+// Populates the envelope with a uniform distribution of count attraction points. Returns no points if the envelope has no volume.
+// Point i is drawn from stream i of a counter_rng, so the points are the same for any number of threads
+std::vector<glm::vec3> populate_envelope(const std::vector<glm::vec2> &curve, uint32_t count, uint64_t seed, int threads);
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// 64-bit FNV-1a hash. Values are added lowest byte first, so the result does not depend on the machine's byte order
+struct fnv_hash
+{
+	uint64_t value = 0xCBF29CE484222325ull;
+
+	void add(uint32_t v)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			value ^= (v >> (i * 8)) & 0xFF;
+			value *= 0x100000001B3ull;
+		}
+	}
+
+	void add(int32_t v)
+	{
+		add(uint32_t(v));
+	}
+
+	void add(uint64_t v)
+	{
+		add(uint32_t(v));
+		add(uint32_t(v >> 32));
+	}
+
+	// Adds the bits of a float, so values that compare equal but differ in sign of zero hash differently
+	void add(float v)
+	{
+		uint32_t bits;
+		memcpy(&bits, &v, sizeof(bits));
+		add(bits);
+	}
+};
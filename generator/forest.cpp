@@ -0,0 +1,55 @@
+#include "forest.h"
+#include "thread_pool.h"
+#include <chrono>
+
+using namespace std;
+
+bool grow_forest(const vector<forest_job> &jobs, int threads, const function<bool(const forest_tree&)> &sink, const tree_cache *cache)
+{
+	thread_pool pool(threads);
+	// Each worker reuses one generator so its buffers are allocated once rather than per tree
+	vector<tree_generator> generators(pool.size());
+	mutex sink_lock;
+	int done = 0;
+	atomic<bool> cancelled(false);
+
+	for (int i = 0; i < jobs.size(); i++)
+		pool.submit([&, i](int worker)
+		{
+			if (cancelled)
+				return;
+			auto begin = chrono::steady_clock::now();
+			tree_generator &generator = generators[worker];
+			vector<float> radii;
+			uint64_t key = tree_key(jobs[i].params, jobs[i].seed);
+			bool cached = cache != nullptr && cache->load(key, generator.nodes, radii);
+			if (!cached)
+			{
+				generator.params = jobs[i].params;
+				// The pool already keeps every core busy
+				generator.params.threads = 1;
+				generator.start(jobs[i].seed);
+				generator.grow();
+				generator.simplify();
+				radii = generator.nodes.pipe_radii();
+				if (cache != nullptr)
+					cache->store(key, generator.nodes, radii);
+			}
+			auto end = chrono::steady_clock::now();
+
+			lock_guard<mutex> guard(sink_lock);
+			forest_tree tree;
+			tree.index = i;
+			tree.done = ++done;
+			tree.total = jobs.size();
+			tree.job = &jobs[i];
+			tree.nodes = &generator.nodes;
+			tree.radii = &radii;
+			tree.ms = chrono::duration<double, milli>(end - begin).count();
+			tree.cached = cached;
+			if (!sink(tree))
+				cancelled = true;
+		});
+	pool.wait();
+	return !cancelled;
+}
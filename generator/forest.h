@@ -0,0 +1,31 @@
+#pragma once
+#include "tree_generator.h"
+#include "tree_cache.h"
+#include <functional>
+
+// One tree of a forest
+struct forest_job
+{
+	tree_parameters params;
+	uint64_t seed = 0;
+};
+
+// A finished tree of a forest. The pointers are only valid while the sink is running
+struct forest_tree
+{
+	int index; // Position of the job in the forest
+	int done; // Trees finished so far, including this one
+	int total;
+	const forest_job *job;
+	const node_tree *nodes;
+	const std::vector<float> *radii; // Branch radius at every node id
+	double ms; // Time taken to generate or load the tree
+	bool cached; // Loaded from the cache rather than generated
+};
+
+// Grows, simplifies and builds the body radii of every job on a work-stealing thread pool. threads of 0 uses every core.
+// Finished trees are passed to sink one at a time and then dropped, so only one tree per thread is held in memory.
+// Returning false from sink skips the jobs that have not been started yet, and grow_forest then returns false.
+// If a cache is given, trees found in it are loaded instead of grown and newly grown trees are stored in it. A tree that cannot be
+// stored is still passed to sink
+bool grow_forest(const std::vector<forest_job> &jobs, int threads, const std::function<bool(const forest_tree&)> &sink, const tree_cache *cache = nullptr);
@@ -0,0 +1,145 @@
+#include "growth_worker.h"
+
+using namespace std;
+
+// Longest the worker grows before checking for requests, in milliseconds
+static const double slice_budget = 2.0;
+
+// Shortest time between snapshots while growing, about a frame, so small passes are not all copied out
+static const chrono::milliseconds publish_interval(16);
+
+growth_worker::~growth_worker()
+{
+	stop();
+}
+
+void growth_worker::start(const tree_parameters &params, uint64_t seed)
+{
+	stop();
+	// The generator keeps its storage from the last tree
+	generator.params = params;
+	stopping = false;
+	running = false;
+	simplify_wanted = false;
+	steps = 0;
+	unpublished = false;
+	// Every tree starts a layout, so the reader redraws it from scratch
+	layout++;
+	simplified = 0;
+	worker = thread(&growth_worker::work, this, seed);
+}
+
+void growth_worker::stop()
+{
+	if (!worker.joinable())
+		return;
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void growth_worker::step()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		steps++;
+	}
+	wake.notify_one();
+}
+
+void growth_worker::run(bool running)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		this->running = running;
+	}
+	wake.notify_one();
+}
+
+void growth_worker::set_debug(bool debug)
+{
+	lock_guard<mutex> guard(lock);
+	this->debug = debug;
+}
+
+void growth_worker::simplify()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		simplify_wanted = true;
+	}
+	wake.notify_one();
+}
+
+void growth_worker::publish()
+{
+	// Every buffer keeps the tree it was last written with. Within a layout nodes are only added, so the buffer only needs the
+	// nodes grown since, added in id order to get the same links. Assigning the rest keeps the capacity of the vectors
+	tree_snapshot &s = snapshots.write();
+	if (s.layout != layout || s.nodes.ids() > generator.nodes.ids())
+		s.nodes = generator.nodes;
+	else
+		for (int id = s.nodes.ids(); id < generator.nodes.ids(); id++)
+			s.nodes.add(generator.nodes.pos[id], generator.nodes.parent[id]);
+	// Every pass already visits every point, so copying them costs no more than the pass
+	s.points = generator.points;
+	s.att_segments = generator.att_segments;
+	s.next_branch_segments = generator.next_branch_segments;
+	s.passes = generator.times.passes;
+	s.finished = generator.finished;
+	s.layout = layout;
+	s.simplified = simplified;
+	snapshots.publish();
+	last_publish = chrono::steady_clock::now();
+	unpublished = false;
+}
+
+void growth_worker::work(uint64_t seed)
+{
+	generator.start(seed);
+	publish();
+	unique_lock<mutex> guard(lock);
+	while (!stopping)
+	{
+		if (simplify_wanted)
+		{
+			simplify_wanted = false;
+			guard.unlock();
+			if (generator.in_pass())
+				generator.single_pass();
+			simplified = generator.simplify();
+			layout++;
+			publish();
+			guard.lock();
+			continue;
+		}
+		// A pass in progress is always finished, so the worker never waits, or publishes, halfway through one
+		bool growing = generator.in_pass() || (!generator.finished && generator.points.size() > 0);
+		if (!growing || (!generator.in_pass() && !running && steps == 0))
+		{
+			// Steps asked for after the tree is finished do nothing
+			steps = 0;
+			// The last passes are shown before waiting
+			if (unpublished)
+				publish();
+			wake.wait(guard);
+			continue;
+		}
+		generator.use_debug = debug;
+		guard.unlock();
+		bool done = generator.grow_slice(slice_budget);
+		if (done)
+		{
+			if (chrono::steady_clock::now() - last_publish >= publish_interval)
+				publish();
+			else
+				unpublished = true;
+		}
+		guard.lock();
+		if (done && steps > 0)
+			steps--;
+	}
+}
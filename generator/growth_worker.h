@@ -0,0 +1,91 @@
+#pragma once
+#include "tree_generator.h"
+#include "triple_buffer.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// State of a growing tree after a pass, copied out of the worker thread
+struct tree_snapshot
+{
+	node_tree nodes; // Attraction directions are not copied
+	std::vector<glm::vec3> points; // Attraction points still alive
+	// Debug output of the pass, only filled in while debugging
+	std::vector<std::pair<glm::vec3, glm::vec3>> att_segments;
+	std::vector<std::pair<glm::vec3, glm::vec3>> next_branch_segments;
+	int passes = 0;
+	bool finished = false;
+	// Nodes are only ever added between snapshots of the same layout, so new ones can be drawn on top of the old ones.
+	// Simplifying removes nodes and starts a new layout
+	int layout = 0;
+	int simplified = 0; // Nodes removed by the simplify that started this layout
+};
+
+// Grows a tree on its own thread and publishes a snapshot after a pass, at most about once a frame and always before waiting
+// for more requests. Snapshots are updated with the nodes grown since they were last written, so publishing does not slow
+// down as the tree grows. The thread works in slices of grow_slice, so requests are picked up within a couple of milliseconds
+// even while passes of a large tree take much longer.
+// Every function is called from one other thread, which is also the only reader of the snapshots
+class growth_worker
+{
+public:
+	growth_worker() {}
+
+	~growth_worker();
+
+	growth_worker(const growth_worker&) = delete;
+	growth_worker &operator=(const growth_worker&) = delete;
+
+	// Stops any tree being grown and starts a new one. It waits for single steps or run until the first pass
+	void start(const tree_parameters &params, uint64_t seed);
+
+	// Stops the thread, dropping the pass in progress
+	void stop();
+
+	// Grows one more pass
+	void step();
+
+	// Keeps growing passes until the tree is finished, or stops after the pass in progress
+	void run(bool running);
+
+	void set_debug(bool debug);
+
+	// Finishes the pass in progress and simplifies the tree, see tree_generator::simplify
+	void simplify();
+
+	// Takes the newest snapshot if the worker has published one since the last call. Returns whether snapshot() changed
+	bool update()
+	{
+		return snapshots.update();
+	}
+
+	// The snapshot taken by the last update. Empty until the worker has published one
+	const tree_snapshot &snapshot() const
+	{
+		return snapshots.read();
+	}
+
+private:
+	tree_generator generator;
+	triple_buffer<tree_snapshot> snapshots;
+	std::thread worker;
+
+	// Requests, guarded by lock
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping = false;
+	bool running = false;
+	bool debug = false;
+	bool simplify_wanted = false;
+	int steps = 0;
+
+	int layout = 0;
+	int simplified = 0;
+	std::chrono::steady_clock::time_point last_publish;
+	bool unpublished = false; // Passes have finished since the last snapshot
+
+	void publish();
+
+	void work(uint64_t seed);
+};
@@ -0,0 +1,112 @@
+#include "mapped_file.h"
+#include <utility>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+mapped_file::mapped_file(const string &path)
+{
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f == INVALID_HANDLE_VALUE)
+		return;
+	file = f;
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(f, &length) || length.QuadPart == 0)
+	{
+		close();
+		return;
+	}
+	mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		close();
+		return;
+	}
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr)
+	{
+		close();
+		return;
+	}
+	size = size_t(length.QuadPart);
+}
+
+void mapped_file::close()
+{
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != nullptr)
+		CloseHandle(file);
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	file = nullptr;
+}
+#else
+mapped_file::mapped_file(const string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		return;
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		void *p = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			data = static_cast<const char*>(p);
+			size = size_t(info.st_size);
+		}
+	}
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+}
+
+void mapped_file::close()
+{
+	if (data != nullptr)
+		munmap(const_cast<char*>(data), size);
+	data = nullptr;
+	size = 0;
+}
+#endif
+
+mapped_file::mapped_file(mapped_file &&other)
+{
+	*this = move(other);
+}
+
+mapped_file &mapped_file::operator=(mapped_file &&other)
+{
+	if (this == &other)
+		return *this;
+	close();
+	swap(data, other.data);
+	swap(size, other.size);
+#ifdef _WIN32
+	swap(file, other.file);
+	swap(mapping, other.mapping);
+#endif
+	return *this;
+}
+
+mapped_file::~mapped_file()
+{
+	close();
+}
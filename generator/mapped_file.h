@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// A whole file mapped read only into memory. The mapping is released when the object is destroyed, so it can be moved but not copied
+struct mapped_file
+{
+	const char *data = nullptr;
+	size_t size = 0;
+
+	mapped_file() {}
+
+	// Maps the file at path. Leaves data null if it does not exist, is empty or cannot be mapped
+	mapped_file(const std::string &path);
+
+	mapped_file(mapped_file &&other);
+
+	mapped_file &operator=(mapped_file &&other);
+
+	mapped_file(const mapped_file&) = delete;
+
+	mapped_file &operator=(const mapped_file&) = delete;
+
+	~mapped_file();
+
+	bool is_open() const
+	{
+		return data != nullptr;
+	}
+
+private:
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#endif
+
+	// Unmaps the file and resets to the empty state
+	void close();
+};
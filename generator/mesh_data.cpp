@@ -0,0 +1,196 @@
+#include "mesh_data.h"
+#include "profiler.h"
+#include <lib/glm/glm/gtc/constants.hpp>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+// Makes a ring's side and forward vectors from its axis alone, so a ring made twice is the same
+static void ring_frame(const vec3 &axis, vec3 &side, vec3 &forward)
+{
+	if (fabs(axis.x) < 0.9f)
+		side = normalize(cross(axis, vec3(1.0f, 0.0f, 0.0f)));
+	else
+		side = normalize(cross(axis, vec3(0.0f, 0.0f, 1.0f)));
+	forward = cross(side, axis);
+}
+
+// Makes two unit vectors perpendicular to the segment from a to b and to each other. Returns the length of the segment
+static float segment_frame(const vec3 &a, const vec3 &b, vec3 &up, vec3 &side, vec3 &forward)
+{
+	float l = length(b - a);
+	up = l != 0.0f ? (b - a) / l : vec3(0.0f, 1.0f, 0.0f);
+	ring_frame(up, side, forward);
+	return l;
+}
+
+void mesh_data::clear()
+{
+	positions.clear();
+	normals.clear();
+	indices.clear();
+}
+
+void mesh_data::append(const mesh_data &m)
+{
+	uint32_t offset = positions.size();
+	positions.insert(positions.end(), m.positions.begin(), m.positions.end());
+	normals.insert(normals.end(), m.normals.begin(), m.normals.end());
+	for (uint32_t i : m.indices)
+		indices.push_back(i + offset);
+}
+
+void mesh_data::add_box(const vec3 &a, const vec3 &b, float width)
+{
+	vec3 up, side, forward;
+	float l = segment_frame(a, b, up, side, forward);
+	vec3 centre = (a + b) / 2.0f;
+	// Zero length segments are drawn as cubes
+	vec3 axes[3] = { side * (width / 2.0f), up * ((l != 0.0f ? l : width) / 2.0f), forward * (width / 2.0f) };
+	for (int axis = 0; axis < 3; axis++)
+		for (float sign = -1.0f; sign <= 1.0f; sign += 2.0f)
+		{
+			// Each face gets its own 4 vertices so the normals stay flat
+			vec3 n = axes[axis] * sign;
+			vec3 u = axes[(axis + 1) % 3];
+			vec3 v = axes[(axis + 2) % 3] * sign;
+			uint32_t first = positions.size();
+			positions.push_back(centre + n - u - v);
+			positions.push_back(centre + n + u - v);
+			positions.push_back(centre + n + u + v);
+			positions.push_back(centre + n - u + v);
+			for (int i = 0; i < 4; i++)
+				normals.push_back(normalize(n));
+			uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+			for (uint32_t q : quad)
+				indices.push_back(first + q);
+		}
+}
+
+// Returns the direction from a to b, or fallback if they are the same point
+static vec3 direction(const vec3 &a, const vec3 &b, const vec3 &fallback)
+{
+	float l = length(b - a);
+	return l != 0.0f ? (b - a) / l : fallback;
+}
+
+// Returns the axis of a node's ring, halfway between the branch coming in and the main branch going out
+static vec3 node_axis(const tree_view &tree, const vector<int32_t> &main, int n)
+{
+	vec3 up = vec3(0.0f, 1.0f, 0.0f);
+	vec3 in = tree.parent[n] != -1 ? direction(tree.pos[tree.parent[n]], tree.pos[n], up) : up;
+	vec3 out = main[n] != -1 ? direction(tree.pos[n], tree.pos[main[n]], in) : in;
+	return direction(vec3(0.0f), in + out, in);
+}
+
+vector<int32_t> main_children(const tree_view &tree)
+{
+	vector<int32_t> main(tree.count, -1);
+	for (uint32_t i = 1; i < tree.count; i++)
+	{
+		int32_t p = tree.parent[i];
+		if (main[p] == -1 || tree.radius[i] > tree.radius[main[p]])
+			main[p] = i;
+	}
+	return main;
+}
+
+void mesh_data::add_branches(const tree_view &tree, const vector<int32_t> &main, int sides, uint32_t first, uint32_t end)
+{
+	struct ring
+	{
+		uint32_t start; // First vertex
+		vec3 side;
+		vec3 forward;
+	};
+	auto add_ring = [&](const vec3 &centre, const vec3 &axis, float radius)
+	{
+		ring r;
+		r.start = positions.size();
+		ring_frame(axis, r.side, r.forward);
+		for (int i = 0; i < sides; i++)
+		{
+			float angle = 2.0f * pi<float>() * i / sides;
+			vec3 n = r.side * cosf(angle) + r.forward * sinf(angle);
+			positions.push_back(centre + n * radius);
+			normals.push_back(n);
+		}
+		return r;
+	};
+
+	// Rings of the nodes in [first, end) once made. Parents before first get a ring of their own in this mesh
+	vector<ring> rings(end - first);
+	vector<bool> made(end - first, false);
+	auto node_ring = [&](uint32_t n)
+	{
+		if (n >= first && made[n - first])
+			return rings[n - first];
+		ring r = add_ring(tree.pos[n], node_axis(tree, main, n), tree.radius[n]);
+		if (n >= first)
+		{
+			rings[n - first] = r;
+			made[n - first] = true;
+		}
+		return r;
+	};
+
+	for (uint32_t i = first > 0 ? first : 1; i < end; i++)
+	{
+		int32_t p = tree.parent[i];
+		// The main child carries on from its parent's ring. Side branches start with a ring of their own inside the parent
+		ring bottom = main[p] == int32_t(i) ? node_ring(p) : add_ring(tree.pos[p], direction(tree.pos[p], tree.pos[i], node_axis(tree, main, p)), tree.radius[i]);
+		ring top = node_ring(i);
+		// Rings are turned to match each other's vertices as closely as the number of sides allows
+		float turn = atan2(dot(top.side, bottom.forward), dot(top.side, bottom.side));
+		int k = int(floor(turn / (2.0f * pi<float>() / sides) + 0.5f));
+		k = ((k % sides) + sides) % sides;
+		for (int s = 0; s < sides; s++)
+		{
+			uint32_t b0 = bottom.start + s;
+			uint32_t b1 = bottom.start + (s + 1) % sides;
+			uint32_t t0 = top.start + (s - k + sides) % sides;
+			uint32_t t1 = top.start + (s + 1 - k + sides) % sides;
+			uint32_t quad[6] = { b0, t0, t1, b0, t1, b1 };
+			for (uint32_t q : quad)
+				indices.push_back(q);
+		}
+		// Close the tips of the twigs
+		if (main[i] == -1)
+		{
+			uint32_t c = positions.size();
+			positions.push_back(tree.pos[i]);
+			normals.push_back(node_axis(tree, main, i));
+			for (int s = 0; s < sides; s++)
+			{
+				indices.push_back(c);
+				indices.push_back(top.start + (s + 1) % sides);
+				indices.push_back(top.start + s);
+			}
+		}
+	}
+}
+
+mesh_data segments_mesh(const vector<pair<vec3, vec3>> &seg, float width)
+{
+	scoped_timer timer("segments_mesh");
+	profiler::count(meshes_created);
+	mesh_data m;
+	m.positions.reserve(seg.size() * 24);
+	m.normals.reserve(seg.size() * 24);
+	m.indices.reserve(seg.size() * 36);
+	for (const pair<vec3, vec3> &s : seg)
+		m.add_box(s.first, s.second, width);
+	return m;
+}
+
+mesh_data body_mesh(const node_tree &nodes, const vector<float> &radii, int sides)
+{
+	scoped_timer timer("body_mesh");
+	profiler::count(meshes_created);
+	flat_tree flat(nodes, radii);
+	tree_view tree = flat.view();
+	mesh_data m;
+	m.add_branches(tree, main_children(tree), sides, 0, tree.count);
+	return m;
+}
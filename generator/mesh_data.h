@@ -0,0 +1,35 @@
+#pragma once
+#include "tree_file.h"
+#include <cstdint>
+
+// Indexed triangle mesh built on the CPU, ready to be uploaded as a single vertex and index buffer
+struct mesh_data
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<uint32_t> indices;
+
+	// Removes every vertex and index
+	void clear();
+
+	// Appends another mesh, offsetting its indices past the vertices already here
+	void append(const mesh_data &m);
+
+	// Appends a box of the given width running from a to b
+	void add_box(const glm::vec3 &a, const glm::vec3 &b, float width);
+
+	// Appends the branches ending at nodes first to end - 1 of a tree as a swept tube. Each node has one ring of the given sides,
+	// shared by the branch coming in and the main branch going out, so joints have no duplicate vertices and no hidden caps.
+	// Side branches start from a ring inside their parent and twigs are closed at the tip. main holds the main child of every node,
+	// from main_children. A parent before first gets a ring of its own, so a tree can be built in pieces
+	void add_branches(const tree_view &tree, const std::vector<int32_t> &main, int sides, uint32_t first, uint32_t end);
+};
+
+// Makes a mesh with a box of the given width along every segment
+mesh_data segments_mesh(const std::vector<std::pair<glm::vec3, glm::vec3>> &seg, float width);
+
+// Returns the main child of every node, the one with the biggest radius, or -1 for twigs
+std::vector<int32_t> main_children(const tree_view &tree);
+
+// Makes the tree body as a swept tube, sized by radii from node_tree::pipe_radii
+mesh_data body_mesh(const node_tree &nodes, const std::vector<float> &radii, int sides);
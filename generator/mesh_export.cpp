@@ -0,0 +1,207 @@
+#include "mesh_export.h"
+#include "profiler.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cfloat>
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+	// Collects the little-endian bytes of one chunk so they go to the file in one write
+	struct le_buffer
+	{
+		vector<char> bytes;
+
+		void u8(uint8_t v)
+		{
+			bytes.push_back(char(v));
+		}
+
+		void u32(uint32_t v)
+		{
+			for (int i = 0; i < 4; i++)
+				bytes.push_back(char((v >> (i * 8)) & 0xFF));
+		}
+
+		void f32(float v)
+		{
+			uint32_t bits;
+			memcpy(&bits, &v, sizeof(bits));
+			u32(bits);
+		}
+
+		void vertex(const vec3 &p, const vec3 &n)
+		{
+			f32(p.x);
+			f32(p.y);
+			f32(p.z);
+			f32(n.x);
+			f32(n.y);
+			f32(n.z);
+		}
+
+		void write(ofstream &out)
+		{
+			out.write(bytes.data(), bytes.size());
+			bytes.clear();
+		}
+	};
+
+	// Totals and bounds of a chunked mesh, found by making every chunk once
+	struct mesh_totals
+	{
+		uint64_t vertices = 0;
+		uint64_t indices = 0;
+		vec3 min = vec3(FLT_MAX);
+		vec3 max = vec3(-FLT_MAX);
+
+		mesh_totals(int chunks, const mesh_chunks &fill)
+		{
+			mesh_data m;
+			for (int c = 0; c < chunks; c++)
+			{
+				m.clear();
+				fill(c, m);
+				vertices += m.positions.size();
+				indices += m.indices.size();
+				for (const vec3 &p : m.positions)
+				{
+					min = glm::min(min, p);
+					max = glm::max(max, p);
+				}
+			}
+		}
+	};
+
+	// Makes every chunk again and writes its vertices as interleaved positions and normals
+	void write_vertices(ofstream &out, int chunks, const mesh_chunks &fill)
+	{
+		mesh_data m;
+		le_buffer buffer;
+		for (int c = 0; c < chunks && out; c++)
+		{
+			m.clear();
+			fill(c, m);
+			for (int i = 0; i < m.positions.size(); i++)
+				buffer.vertex(m.positions[i], m.normals[i]);
+			buffer.write(out);
+		}
+	}
+}
+
+body_chunks::body_chunks(const vector<tree_view> &trees, int sides, uint32_t branches_per_chunk)
+{
+	this->trees = trees;
+	this->sides = sides;
+	// The root has no branch of its own
+	for (int t = 0; t < trees.size(); t++)
+	{
+		main.push_back(main_children(trees[t]));
+		for (uint32_t first = 1; first < trees[t].count; first += branches_per_chunk)
+			starts.push_back(pair<int, uint32_t>(t, first));
+	}
+}
+
+void body_chunks::fill(int chunk, mesh_data &m) const
+{
+	scoped_timer timer("body_chunk");
+	profiler::count(meshes_created);
+	const tree_view &tree = trees[starts[chunk].first];
+	uint32_t first = starts[chunk].second;
+	uint32_t end = chunk + 1 < starts.size() && starts[chunk + 1].first == starts[chunk].first ? starts[chunk + 1].second : tree.count;
+	m.add_branches(tree, main[starts[chunk].first], sides, first, end);
+}
+
+bool export_ply(const string &path, int chunks, const mesh_chunks &fill)
+{
+	mesh_totals totals(chunks, fill);
+	ofstream out(path, ios::binary);
+	out << "ply\n";
+	out << "format binary_little_endian 1.0\n";
+	out << "comment Procedural tree body\n";
+	out << "element vertex " << totals.vertices << "\n";
+	out << "property float x\nproperty float y\nproperty float z\n";
+	out << "property float nx\nproperty float ny\nproperty float nz\n";
+	out << "element face " << totals.indices / 3 << "\n";
+	out << "property list uchar uint vertex_indices\n";
+	out << "end_header\n";
+	write_vertices(out, chunks, fill);
+
+	// Faces come after every vertex, so the chunks are made a third time and their indices moved past earlier chunks
+	mesh_data m;
+	le_buffer buffer;
+	uint32_t offset = 0;
+	for (int c = 0; c < chunks && out; c++)
+	{
+		m.clear();
+		fill(c, m);
+		for (int i = 0; i + 2 < m.indices.size(); i += 3)
+		{
+			buffer.u8(3);
+			buffer.u32(m.indices[i] + offset);
+			buffer.u32(m.indices[i + 1] + offset);
+			buffer.u32(m.indices[i + 2] + offset);
+		}
+		buffer.write(out);
+		offset += m.positions.size();
+	}
+	return bool(out);
+}
+
+bool export_glb(const string &path, int chunks, const mesh_chunks &fill)
+{
+	mesh_totals totals(chunks, fill);
+	uint64_t vertex_bytes = totals.vertices * 24;
+	uint64_t bin_bytes = vertex_bytes + totals.indices * 4;
+
+	// Bounds are printed with enough digits to read back as the same floats, as glTF checks them against the data
+	ostringstream json;
+	json.precision(9);
+	json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"ProceduralTrees\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+		<< "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":2}]}],"
+		<< "\"buffers\":[{\"byteLength\":" << bin_bytes << "}],"
+		<< "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << vertex_bytes << ",\"byteStride\":24,\"target\":34962},"
+		<< "{\"buffer\":0,\"byteOffset\":" << vertex_bytes << ",\"byteLength\":" << totals.indices * 4 << ",\"target\":34963}],"
+		<< "\"accessors\":[{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":" << totals.vertices << ",\"type\":\"VEC3\","
+		<< "\"min\":[" << totals.min.x << "," << totals.min.y << "," << totals.min.z << "],"
+		<< "\"max\":[" << totals.max.x << "," << totals.max.y << "," << totals.max.z << "]},"
+		<< "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":" << totals.vertices << ",\"type\":\"VEC3\"},"
+		<< "{\"bufferView\":1,\"byteOffset\":0,\"componentType\":5125,\"count\":" << totals.indices << ",\"type\":\"SCALAR\"}]}";
+	string text = json.str();
+	// Chunks are padded to 4 bytes, JSON with spaces
+	while (text.size() % 4 != 0)
+		text += ' ';
+	uint64_t total = 12 + 8 + text.size() + 8 + bin_bytes;
+	if (totals.vertices == 0 || total > UINT32_MAX)
+		return false;
+
+	ofstream out(path, ios::binary);
+	le_buffer buffer;
+	buffer.u32(0x46546C67); // "glTF"
+	buffer.u32(2);
+	buffer.u32(uint32_t(total));
+	buffer.u32(uint32_t(text.size()));
+	buffer.u32(0x4E4F534A); // "JSON"
+	buffer.write(out);
+	out.write(text.data(), text.size());
+	buffer.u32(uint32_t(bin_bytes));
+	buffer.u32(0x004E4942); // "BIN"
+	buffer.write(out);
+	write_vertices(out, chunks, fill);
+
+	mesh_data m;
+	uint32_t offset = 0;
+	for (int c = 0; c < chunks && out; c++)
+	{
+		m.clear();
+		fill(c, m);
+		for (uint32_t i : m.indices)
+			buffer.u32(i + offset);
+		buffer.write(out);
+		offset += m.positions.size();
+	}
+	return bool(out);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "mesh_data.h"
+#include "tree_file.h"
+#include <functional>
+#include <string>
+
+// Fills m with one chunk of a mesh. Chunks number their own vertices from 0, and must come out the same every time they are made,
+// as the exporters make every chunk more than once rather than holding the whole mesh
+typedef std::function<void(int chunk, mesh_data &m)> mesh_chunks;
+
+// Splits the bodies of a set of trees into chunks of at most branches_per_chunk branches, swept with rings of the given sides.
+// Trees keep their own coordinates
+struct body_chunks
+{
+	std::vector<tree_view> trees;
+	int sides;
+	std::vector<std::vector<int32_t>> main; // Main children of every tree
+	std::vector<std::pair<int, uint32_t>> starts; // Tree and first node of every chunk
+
+	body_chunks(const std::vector<tree_view> &trees, int sides, uint32_t branches_per_chunk = 4096);
+
+	int count() const
+	{
+		return starts.size();
+	}
+
+	void fill(int chunk, mesh_data &m) const;
+};
+
+// Streams a mesh to a binary little-endian PLY file. Memory use is one chunk however big the mesh is
+bool export_ply(const std::string &path, int chunks, const mesh_chunks &fill);
+
+// Streams a mesh to a glTF binary (.glb) file with interleaved positions and normals. A first pass finds the counts and exact bounds
+// the glTF header needs, so memory use is one chunk however big the mesh is. Returns false if the mesh is over glb's 4GB limit
+bool export_glb(const std::string &path, int chunks, const mesh_chunks &fill);
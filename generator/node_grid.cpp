@@ -0,0 +1,264 @@
+#include "node_grid.h"
+
+using namespace std;
+using namespace glm;
+
+const int64_t node_grid::cell_table::no_key;
+
+void node_grid::cell_table::clear()
+{
+	if (cells == 0)
+		return;
+	for (size_t i = 0; i < keys.size(); i++)
+		if (keys[i] != no_key)
+		{
+			keys[i] = no_key;
+			slots[i].entries.clear();
+			fill(slots[i].fine_heads.begin(), slots[i].fine_heads.end(), -1);
+		}
+	cells = 0;
+}
+
+size_t node_grid::cell_table::find_slot(int64_t k) const
+{
+	// Neighbouring cells have close keys, so they are mixed before picking a slot
+	uint64_t h = uint64_t(k) * 0x9E3779B97F4A7C15ull;
+	size_t mask = keys.size() - 1;
+	size_t i = size_t(h >> 32) & mask;
+	while (keys[i] != k && keys[i] != no_key)
+		i = (i + 1) & mask;
+	return i;
+}
+
+const node_grid::cell *node_grid::cell_table::find(int64_t k) const
+{
+	if (cells == 0)
+		return nullptr;
+	size_t i = find_slot(k);
+	return keys[i] == no_key ? nullptr : &slots[i];
+}
+
+void node_grid::cell_table::grow()
+{
+	vector<int64_t> old_keys;
+	vector<cell> old_slots;
+	old_keys.swap(keys);
+	old_slots.swap(slots);
+	keys.assign(std::max(old_keys.size() * 2, size_t(64)), no_key);
+	slots.resize(keys.size());
+	// Empty buffers of free slots are kept too, in the free slots of the new table
+	vector<cell> spare;
+	for (size_t i = 0; i < old_keys.size(); i++)
+		if (old_keys[i] != no_key)
+		{
+			size_t j = find_slot(old_keys[i]);
+			keys[j] = old_keys[i];
+			swap(slots[j], old_slots[i]);
+		}
+		else if (old_slots[i].entries.capacity() > 0)
+			spare.push_back(move(old_slots[i]));
+	for (size_t i = 0; i < keys.size() && spare.size() > 0; i++)
+		if (keys[i] == no_key)
+		{
+			swap(slots[i], spare.back());
+			spare.pop_back();
+		}
+}
+
+node_grid::cell &node_grid::cell_table::insert(int64_t k, const entry &e)
+{
+	// Kept at most half full so probes stay short
+	if ((cells + 1) * 2 > int(keys.size()))
+		grow();
+	size_t i = find_slot(k);
+	if (keys[i] == no_key)
+	{
+		keys[i] = k;
+		cells++;
+	}
+	slots[i].entries.push_back(e);
+	return slots[i];
+}
+
+size_t node_grid::cell_table::storage_bytes() const
+{
+	size_t bytes = keys.capacity() * sizeof(int64_t) + slots.capacity() * sizeof(cell);
+	for (const cell &c : slots)
+		bytes += c.entries.capacity() * sizeof(entry) + c.fine_heads.capacity() * sizeof(int);
+	return bytes;
+}
+
+void node_grid::reset(float cell_size, int splits)
+{
+	this->cell_size = cell_size;
+	this->splits = splits;
+	cells.clear();
+	fine_entries.clear();
+}
+
+void node_grid::insert(int id, const vec3 &pos)
+{
+	entry e;
+	e.id = id;
+	e.pos = pos;
+	ivec3 f = fine_cell_of(pos);
+	ivec3 c = cell_of_fine(f);
+	cell &inserted = cells.insert(key(c), e);
+	if (splits == 1)
+		return;
+	if (inserted.fine_heads.size() != splits * splits * splits)
+		inserted.fine_heads.assign(splits * splits * splits, -1);
+	ivec3 local = f - c * splits;
+	int &head = inserted.fine_heads[(local.x * splits + local.y) * splits + local.z];
+	fine_entry fe;
+	fe.e = e;
+	fe.next = head;
+	head = fine_entries.size();
+	fine_entries.push_back(fe);
+}
+
+void node_grid::rebuild(const node_tree &tree)
+{
+	cells.clear();
+	fine_entries.clear();
+	for (int id = 0; id < tree.ids(); id++)
+		if (!tree.removed[id])
+			insert(id, tree.pos[id]);
+}
+
+bool node_grid::further(const vec3 &corner, float size, const vec3 &point, float d2)
+{
+	// The cube is padded a little, as rounding can put a node just outside the cell it was filed in
+	float pad = size * 0.001f;
+	vec3 outside = glm::max(glm::max(corner - vec3(pad) - point, point - (corner + vec3(size + pad))), vec3(0.0f));
+	return length2(outside) > d2;
+}
+
+int node_grid::closest_node(const vec3 &point, const float &max_d) const
+{
+	int closest = -1;
+	float closest_d2 = max_d * max_d;
+	ivec3 lo = cell_of(point - vec3(max_d));
+	ivec3 hi = cell_of(point + vec3(max_d));
+	// Crowded cells are left until the others have given a closest node to bound the search. Searches of more than a cell
+	// either side check every node
+	bool split = splits > 1 && all(lessThanEqual(hi - lo, ivec3(2)));
+	const cell *crowded_cells[27];
+	ivec3 firsts[27]; // First fine cell of each crowded cell
+	int count = 0;
+	for (int x = lo.x; x <= hi.x; x++)
+		for (int y = lo.y; y <= hi.y; y++)
+			for (int z = lo.z; z <= hi.z; z++)
+			{
+				const cell *c = cells.find(key(ivec3(x, y, z)));
+				if (c == nullptr || further(vec3(ivec3(x, y, z)) * cell_size, cell_size, point, closest_d2))
+					continue;
+				if (!split || c->entries.size() <= crowded)
+					for (const entry &e : c->entries)
+						closer(e, point, closest, closest_d2);
+				else
+				{
+					crowded_cells[count] = c;
+					firsts[count++] = ivec3(x, y, z) * splits;
+				}
+			}
+	if (count == 0)
+		return closest;
+	float fine_size = cell_size / splits;
+	ivec3 centre = fine_cell_of(point);
+	// Every fine cell of shell r is at least r - 1 fine cells plus the gap to the nearest face of the centre cell away from the point
+	vec3 f = point / fine_size - vec3(centre);
+	float gap = glm::max(0.0f, glm::min(glm::min(glm::min(f.x, 1.0f - f.x), glm::min(f.y, 1.0f - f.y)), glm::min(f.z, 1.0f - f.z))) * fine_size;
+	for (int r = 0; ; r++)
+	{
+		float shell_d = r == 0 ? 0.0f : (r - 1) * fine_size + gap;
+		if (shell_d * shell_d > closest_d2)
+			break;
+		// Each crowded cell is searched where the shell crosses it
+		bool outside = false;
+		for (int i = 0; i < count; i++)
+		{
+			ivec3 last = firsts[i] + ivec3(splits - 1);
+			ivec3 a = glm::max(centre - ivec3(r), firsts[i]);
+			ivec3 b = glm::min(centre + ivec3(r), last);
+			outside = outside || !all(lessThanEqual(centre - ivec3(r), firsts[i])) || !all(greaterThanEqual(centre + ivec3(r), last));
+			if (!all(lessThanEqual(a, b)))
+				continue;
+			const vector<int> &heads = crowded_cells[i]->fine_heads;
+			auto search = [&](int x, int y, int z)
+			{
+				ivec3 local = ivec3(x, y, z) - firsts[i];
+				int next = heads[(local.x * splits + local.y) * splits + local.z];
+				if (next == -1 || further(vec3(ivec3(x, y, z)) * fine_size, fine_size, point, closest_d2))
+					return;
+				for (; next != -1; next = fine_entries[next].next)
+					closer(fine_entries[next].e, point, closest, closest_d2);
+			};
+			for (int x = a.x; x <= b.x; x++)
+				for (int y = a.y; y <= b.y; y++)
+					if (abs(x - centre.x) == r || abs(y - centre.y) == r)
+						for (int z = a.z; z <= b.z; z++)
+							search(x, y, z);
+					else
+					{
+						// Inside the shell only its two faces along z are searched
+						if (centre.z - r >= a.z)
+							search(x, y, centre.z - r);
+						if (centre.z + r <= b.z)
+							search(x, y, centre.z + r);
+					}
+		}
+		// Shells end once they hold every crowded cell
+		if (!outside)
+			break;
+	}
+	return closest;
+}
+
+bool node_grid::is_closer_than(const vec3 &point, const float &d) const
+{
+	ivec3 lo = cell_of(point - vec3(d));
+	ivec3 hi = cell_of(point + vec3(d));
+	for (int x = lo.x; x <= hi.x; x++)
+		for (int y = lo.y; y <= hi.y; y++)
+			for (int z = lo.z; z <= hi.z; z++)
+			{
+				const cell *c = cells.find(key(ivec3(x, y, z)));
+				if (c == nullptr)
+					continue;
+				for (const entry &e : c->entries)
+					if (length2(point - e.pos) < d * d)
+						return true;
+			}
+	return false;
+}
+
+size_t node_grid::storage_bytes() const
+{
+	return cells.storage_bytes() + fine_entries.capacity() * sizeof(fine_entry);
+}
+
+ivec3 node_grid::fine_cell_of(const vec3 &p) const
+{
+	return ivec3(floor(p / (cell_size / splits)));
+}
+
+ivec3 node_grid::cell_of_fine(const ivec3 &f) const
+{
+	// Rounds down for negative coordinates too
+	ivec3 c;
+	for (int i = 0; i < 3; i++)
+		c[i] = f[i] >= 0 ? f[i] / splits : -((-f[i] - 1) / splits) - 1;
+	return c;
+}
+
+ivec3 node_grid::cell_of(const vec3 &p) const
+{
+	return cell_of_fine(fine_cell_of(p));
+}
+
+int64_t node_grid::key(const ivec3 &c)
+{
+	const int64_t mask = (1 << 21) - 1;
+	return ((int64_t(c.x) & mask) << 42) | ((int64_t(c.y) & mask) << 21) | (int64_t(c.z) & mask);
+}
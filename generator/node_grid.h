@@ -0,0 +1,126 @@
+#pragma once
+#include "node_tree.h"
+#include <cstdint>
+
+// Uniform grid of nodes keyed on node position. Used to find the closest node to a point without walking the whole tree.
+// Cells can be split into fine cells, so crowded cells are searched from the point outwards instead of node by node.
+// Cells live in an open addressing table whose slots keep their buffers when the grid is cleared, and fine cells are lists in
+// one shared pool, so a grid that is reused for pass after pass and tree after tree stops allocating once it has held its
+// largest set of nodes
+struct node_grid
+{
+	struct entry
+	{
+		int id;
+		glm::vec3 pos;
+	};
+
+	float cell_size = 1.0f;
+	int splits = 1; // Fine cells along each side of a cell
+
+	node_grid() {}
+
+	node_grid(float cell_size, int splits = 1)
+	{
+		this->cell_size = cell_size;
+		this->splits = splits;
+	}
+
+	// Removes every node and sets the cell size, keeping the storage
+	void reset(float cell_size, int splits = 1);
+
+	// Adds a node to the cell containing its position
+	void insert(int id, const glm::vec3 &pos);
+
+	// Clears the grid and adds every node of the given tree
+	void rebuild(const node_tree &tree);
+
+	// Returns the id of the closest node no further than max_d from the point, or -1 if there is none. Of nodes at the same
+	// distance the lowest id wins. Cells with few nodes are checked node by node. Crowded cells are searched a shell of fine
+	// cells at a time outwards from the point, stopping once a shell is further away than the closest node found or max_d
+	int closest_node(const glm::vec3 &point, const float &max_d) const;
+
+	// Returns whether or not any node in the grid is closer to given point than distance d
+	bool is_closer_than(const glm::vec3 &point, const float &d) const;
+
+	// Returns whether the grid holds no nodes
+	bool empty() const
+	{
+		return cells.cells == 0;
+	}
+
+	// Returns the bytes of storage held, used or not
+	size_t storage_bytes() const;
+
+private:
+	// Cells with more nodes than this are searched by fine cell
+	static const int crowded = 128;
+
+	struct cell
+	{
+		std::vector<entry> entries;
+		std::vector<int> fine_heads; // First fine entry of each fine cell, or -1. Only kept when cells are split
+	};
+
+	// A node in a list of the nodes in a fine cell
+	struct fine_entry
+	{
+		entry e;
+		int next; // Index of the next fine entry in the same fine cell, or -1
+	};
+
+	// Open addressing table of cells
+	struct cell_table
+	{
+		static const int64_t no_key = -1; // Marks a free slot, as packed keys never set the top bit
+
+		std::vector<int64_t> keys; // Key of the cell in every slot. The number of slots is a power of two
+		std::vector<cell> slots; // The cell in every slot
+		int cells = 0; // Slots in use
+
+		// Empties every cell, keeping the slots and their buffers
+		void clear();
+
+		// Adds an entry to a cell and returns the cell
+		cell &insert(int64_t k, const entry &e);
+
+		// Returns the cell, or nullptr if the cell is empty
+		const cell *find(int64_t k) const;
+
+		size_t storage_bytes() const;
+
+	private:
+		// Returns the slot holding the key, or the free slot it would go in. There must be a free slot
+		size_t find_slot(int64_t k) const;
+
+		// Doubles the number of slots, moving every cell into its new slot
+		void grow();
+	};
+
+	cell_table cells;
+	std::vector<fine_entry> fine_entries; // Only filled when cells are split
+
+	glm::ivec3 fine_cell_of(const glm::vec3 &p) const;
+
+	// The cell holding a fine cell. Found from the fine cell, so a node is always inside its cell's fine cells
+	glm::ivec3 cell_of_fine(const glm::ivec3 &f) const;
+
+	glm::ivec3 cell_of(const glm::vec3 &p) const;
+
+	// Returns whether every point of the cube with the given corner and size is further than the square root of d2 from the point
+	static bool further(const glm::vec3 &corner, float size, const glm::vec3 &point, float d2);
+
+	// Checks a node against the closest one found so far
+	static void closer(const entry &e, const glm::vec3 &point, int &closest, float &closest_d2)
+	{
+		float d2 = glm::length2(point - e.pos);
+		if (d2 < closest_d2 || (d2 == closest_d2 && (closest == -1 || e.id < closest)))
+		{
+			closest = e.id;
+			closest_d2 = d2;
+		}
+	}
+
+	// Packs cell coordinates into 21 bits each
+	static int64_t key(const glm::ivec3 &c);
+};
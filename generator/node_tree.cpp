@@ -0,0 +1,253 @@
+#include "node_tree.h"
+#include "fnv_hash.h"
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+void node_tree::clear()
+{
+	count = 0;
+	pos.clear();
+	att_dir.clear();
+	parent.clear();
+	first_child.clear();
+	next_sibling.clear();
+	removed.clear();
+}
+
+size_t node_tree::storage_bytes() const
+{
+	return (pos.capacity() + att_dir.capacity()) * sizeof(vec3) + (parent.capacity() + first_child.capacity() + next_sibling.capacity()) * sizeof(int) + removed.capacity() / 8;
+}
+
+int node_tree::add(const vec3 &p, int parent_id)
+{
+	int id = pos.size();
+	pos.push_back(p);
+	att_dir.push_back(vec3(0.0f));
+	parent.push_back(parent_id);
+	first_child.push_back(-1);
+	next_sibling.push_back(-1);
+	removed.push_back(false);
+	count++;
+	if (parent_id >= 0)
+	{
+		next_sibling[id] = first_child[parent_id];
+		first_child[parent_id] = id;
+	}
+	return id;
+}
+
+void node_tree::clear_attractions()
+{
+	for (vec3 &a : att_dir)
+		a = vec3(0.0f);
+}
+
+void node_tree::normalise_attractions()
+{
+	for (vec3 &a : att_dir)
+		if (a != vec3(0.0f))
+			a = normalize(a);
+}
+
+void node_tree::colonise_nodes(const float &d, tropisms tropism, vector<int> &added)
+{
+	int existing = pos.size();
+	vec3 zero = vec3(0.0f);
+	for (int id = 0; id < existing; id++)
+	{
+		if (removed[id] || att_dir[id] == zero)
+			continue;
+		vec3 n = apply_tropism(tropism, att_dir[id], pos[id]);
+		vec3 branch = pos[id] + (n * d);
+		if (!(first_child[id] != -1 && pos[first_child[id]] == branch))
+			added.push_back(add(branch, id));
+	}
+}
+
+vector<pair<vec3, vec3>> node_tree::get_segments() const
+{
+	vector<pair<vec3, vec3>> v;
+	for (int id = 1; id < pos.size(); id++)
+		if (!removed[id])
+			v.push_back(pair<vec3, vec3>(pos[parent[id]], pos[id]));
+	return v;
+}
+
+// Directions from the start of a straight branch that its end may lie in, as a circular cone. Every node the branch replaces
+// narrows the cone to the directions passing within the error of it. Cones do not intersect into cones, so the largest cone
+// inside both is kept, which may end a branch early but never lets it stray too far
+struct direction_cone
+{
+	vec3 axis = vec3(0.0f);
+	float angle = -1.0f; // Half angle, negative while any direction is allowed
+	bool empty = false;
+
+	// Angle between unit vectors, accurate for small angles unlike acos
+	static float between(const vec3 &a, const vec3 &b)
+	{
+		return atan2f(length(cross(a, b)), dot(a, b));
+	}
+
+	bool contains(const vec3 &dir) const
+	{
+		return !empty && (angle < 0.0f || between(axis, dir) <= angle);
+	}
+
+	// Narrows the cone to the part also within the given half angle of dir
+	void narrow(const vec3 &dir, float a)
+	{
+		if (empty)
+			return;
+		if (angle < 0.0f)
+		{
+			axis = dir;
+			angle = a;
+			return;
+		}
+		float d = between(axis, dir);
+		if (d + a <= angle)
+		{
+			axis = dir;
+			angle = a;
+		}
+		else if (d + angle > a)
+		{
+			if (d >= angle + a)
+			{
+				empty = true;
+				return;
+			}
+			// The largest cone in the overlap sits halfway across it, on the arc between the two axes
+			float from = (d + angle - a) * 0.5f;
+			axis = normalize(axis * sinf(d - from) + dir * sinf(from));
+			angle = (angle + a - d) * 0.5f;
+		}
+	}
+};
+
+// Removes the nodes of a chain between positions from and to, making the node at to a child of the node at from
+// in the place the first removed node had among its siblings
+static void skip_nodes(node_tree &tree, const vector<int> &chain, int from, int to)
+{
+	if (to - from < 2)
+		return;
+	int p = chain[from];
+	int first = chain[from + 1];
+	int keep = chain[to];
+	for (int m = from + 1; m < to; m++)
+	{
+		tree.removed[chain[m]] = true;
+		tree.count--;
+	}
+	tree.parent[keep] = p;
+	tree.next_sibling[keep] = tree.next_sibling[first];
+	if (tree.first_child[p] == first)
+		tree.first_child[p] = keep;
+	else
+		for (int s = tree.first_child[p]; s != -1; s = tree.next_sibling[s])
+			if (tree.next_sibling[s] == first)
+			{
+				tree.next_sibling[s] = keep;
+				break;
+			}
+}
+
+int node_tree::simplify(float max_error)
+{
+	int before = count;
+	vector<int> children;
+	vector<int> chain;
+	for (int id = 0; id < pos.size(); id++)
+	{
+		if (removed[id])
+			continue;
+		// Chains start at the root and at branching nodes. Nodes with one child are only walked through
+		if (id != 0 && first_child[id] != -1 && next_sibling[first_child[id]] == -1)
+			continue;
+		children.clear();
+		for (int c = first_child[id]; c != -1; c = next_sibling[c])
+			children.push_back(c);
+		for (int c : children)
+		{
+			chain.clear();
+			chain.push_back(id);
+			chain.push_back(c);
+			for (int n = c; first_child[n] != -1 && next_sibling[first_child[n]] == -1; n = first_child[n])
+				chain.push_back(first_child[n]);
+			// Stretch a straight branch from the last kept node as far along the chain as the error allows. A node m is within
+			// max_error of the branch if the branch points within asin(max_error / |m|) of it and reaches at least as far, so only
+			// the cone of allowed directions and the furthest node need keeping and every node is tested once
+			int kept = 0;
+			direction_cone cone;
+			float reach = 0.0f;
+			for (int end = 1; end < chain.size(); end++)
+			{
+				vec3 v = pos[chain[end]] - pos[chain[kept]];
+				float d = length(v);
+				if (end > kept + 1 && !(d >= reach && (d == 0.0f || cone.contains(v / d))))
+				{
+					skip_nodes(*this, chain, kept, end - 1);
+					kept = end - 1;
+					cone = direction_cone();
+					reach = 0.0f;
+					v = pos[chain[end]] - pos[chain[kept]];
+					d = length(v);
+				}
+				// Nodes within max_error of the start are close enough to any branch from it
+				reach = glm::max(reach, d);
+				if (d > max_error)
+					cone.narrow(v / d, asinf(max_error / d));
+			}
+			skip_nodes(*this, chain, kept, chain.size() - 1);
+		}
+	}
+	return before - count;
+}
+
+vector<float> node_tree::pipe_radii() const
+{
+	vector<float> scale(pos.size(), 0.0f);
+	float k = 2.3f;
+	for (int id = pos.size() - 1; id >= 0; id--)
+	{
+		if (removed[id])
+			continue;
+		if (first_child[id] == -1)
+		{
+			scale[id] = 0.03f;
+			continue;
+		}
+		bool branching = next_sibling[first_child[id]] != -1;
+		for (int c = first_child[id]; c != -1; c = next_sibling[c])
+			if (branching)
+				scale[id] += powf(scale[c], k);
+			else
+				scale[id] = scale[c];
+		if (branching)
+			scale[id] = pow(scale[id], 1.0f / k);
+	}
+	return scale;
+}
+
+uint64_t node_tree::checksum() const
+{
+	// Live nodes are numbered in id order, so a tree with its removed nodes dropped has the same checksum
+	vector<int> rank(pos.size(), -1);
+	int n = 0;
+	fnv_hash hash;
+	for (int id = 0; id < pos.size(); id++)
+	{
+		if (removed[id])
+			continue;
+		rank[id] = n;
+		hash.add(int32_t(n++));
+		hash.add(int32_t(parent[id] == -1 ? -1 : rank[parent[id]]));
+		hash.add(pos[id].x);
+		hash.add(pos[id].y);
+		hash.add(pos[id].z);
+	}
+	return hash.value;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <lib/glm/glm/glm.hpp>
+#include <lib/glm/glm/gtx/norm.hpp>
+#include "tropism.h"
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Tree of nodes stored in flat arrays indexed by node id. Node 0 is the root and children always have a higher id than their parent
+struct node_tree
+{
+	std::vector<glm::vec3> pos;
+	std::vector<glm::vec3> att_dir; // Attraction direction
+	std::vector<int> parent;
+	std::vector<int> first_child; // Newest child, -1 if none
+	std::vector<int> next_sibling; // Next older sibling, -1 if none
+	std::vector<bool> removed; // Nodes merged away by simplify keep their slot so other ids stay valid
+	int count = 0; // Number of nodes that have not been removed
+
+	// Removes every node from the tree, keeping the storage for the next one
+	void clear();
+
+	// Returns the bytes of storage held, used or not
+	size_t storage_bytes() const;
+
+	// Adds a node as the newest child of parent (-1 for the root) and returns its id
+	int add(const glm::vec3 &p, int parent_id);
+
+	// Returns the number of nodes in the tree
+	int size() const
+	{
+		return count;
+	}
+
+	// Returns the number of ids handed out so far, including removed nodes. Ids never change once given out
+	int ids() const
+	{
+		return pos.size();
+	}
+
+	// Returns the id of the most recently added node, which is always a leaf
+	int newest() const
+	{
+		return pos.size() - 1;
+	}
+
+	// Sets all attraction direction points to 0
+	void clear_attractions();
+
+	// Normalises all the attraction direction vectors
+	void normalise_attractions();
+
+	// Adds child nodes to nodes that have a non-zero att_dir along that vector, bent by the tropism, at a distance d. Ids of new nodes are appended to added
+	void colonise_nodes(const float &d, tropisms tropism, std::vector<int> &added);
+
+	// Returns all line segments in between nodes
+	std::vector<std::pair<glm::vec3, glm::vec3>> get_segments() const;
+
+	// Removes nodes from chains of single child nodes wherever the straight branch that replaces them passes within max_error
+	// of every removed node, so the skeleton never moves further than that from where it grew. Branching nodes and twig tips are
+	// always kept. Visits every node once, testing it in constant time, and returns the number of nodes removed. The test is
+	// conservative, so some nodes that could go are kept. Calling it again measures from the simplified skeleton
+	int simplify(float max_error);
+
+	// Returns the branch radius at every node id using the pipe model. Removed nodes get 0
+	std::vector<float> pipe_radii() const;
+
+	// Returns a 64-bit FNV-1a hash of the parent and position bits of every live node in id order. Removed nodes are skipped
+	// and the rest numbered in order, so a compacted copy of a tree has the same checksum
+	uint64_t checksum() const;
+};
@@ -0,0 +1,25 @@
+#include "parallel.h"
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+void parallel_for(int count, int threads, const function<void(int, int)> &fn)
+{
+	if (threads <= 0)
+		threads = thread::hardware_concurrency();
+	// Small batches are not worth starting threads for
+	threads = std::min(threads, count / 512);
+	if (threads <= 1)
+	{
+		fn(0, count);
+		return;
+	}
+	vector<thread> workers;
+	for (int t = 1; t < threads; t++)
+		workers.push_back(thread(fn, count * t / threads, count * (t + 1) / threads));
+	fn(0, count / threads);
+	for (thread &w : workers)
+		w.join();
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include <functional>
+
+// Splits [0, count) into contiguous ranges and runs fn(begin, end) on each range in its own thread. threads of 0 uses every core
+void parallel_for(int count, int threads, const std::function<void(int, int)> &fn);
@@ -0,0 +1,162 @@
+#include "profiler.h"
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> profiler::on(false);
+atomic<int64_t> profiler::counters[profile_counter_count];
+
+static const char *counter_names[profile_counter_count] = { "nearest_queries", "nodes_added", "points_killed", "meshes_created", "draw_calls" };
+
+// One finished timer
+struct profile_event
+{
+	const char *name;
+	int64_t begin;
+	int64_t duration;
+	int thread;
+};
+
+// Totals of one iteration
+struct profile_row
+{
+	int64_t end;
+	map<string, double> ms;
+	int64_t counts[profile_counter_count];
+};
+
+static mutex records_lock;
+static atomic<int64_t> epoch(0);
+static atomic<int> next_thread(0);
+static vector<profile_event> events;
+static vector<profile_row> rows;
+static map<string, double> current; // Timer totals of the iteration not yet ended
+static int64_t last_counts[profile_counter_count];
+
+static int64_t steady_us()
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profiler::enable(bool state)
+{
+	lock_guard<mutex> guard(records_lock);
+	if (state && !on)
+	{
+		events.clear();
+		rows.clear();
+		current.clear();
+		for (int c = 0; c < profile_counter_count; c++)
+		{
+			counters[c] = 0;
+			last_counts[c] = 0;
+		}
+		epoch = steady_us();
+	}
+	// Whatever ran after the last iteration, such as building the meshes, gets a row of its own
+	if (!state && on && current.size() > 0)
+		add_row(now());
+	on = state;
+}
+
+int64_t profiler::now()
+{
+	return steady_us() - epoch.load(memory_order_relaxed);
+}
+
+void profiler::record(const char *name, int64_t begin, int64_t end)
+{
+	// Small ids read better in a trace viewer than native thread ids
+	static thread_local int thread = next_thread++;
+	lock_guard<mutex> guard(records_lock);
+	profile_event e = { name, begin, end - begin, thread };
+	events.push_back(e);
+	current[name] += (end - begin) / 1000.0;
+}
+
+void profiler::add_row(int64_t end)
+{
+	profile_row row;
+	row.end = end;
+	row.ms = move(current);
+	current.clear();
+	for (int c = 0; c < profile_counter_count; c++)
+	{
+		int64_t total = counters[c].load(memory_order_relaxed);
+		row.counts[c] = total - last_counts[c];
+		last_counts[c] = total;
+	}
+	rows.push_back(row);
+}
+
+void profiler::end_iteration()
+{
+	if (!enabled())
+		return;
+	int64_t end = now();
+	lock_guard<mutex> guard(records_lock);
+	add_row(end);
+}
+
+bool profiler::write_trace(const string &file)
+{
+	ofstream out(file);
+	if (!out)
+		return false;
+	lock_guard<mutex> guard(records_lock);
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (const profile_event &e : events)
+	{
+		out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread << ",\"ts\":" << e.begin << ",\"dur\":" << e.duration << "}";
+		first = false;
+	}
+	for (const profile_row &r : rows)
+	{
+		out << (first ? "\n" : ",\n") << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << r.end << ",\"args\":{";
+		for (int c = 0; c < profile_counter_count; c++)
+			out << (c > 0 ? "," : "") << "\"" << counter_names[c] << "\":" << r.counts[c];
+		out << "}}";
+		first = false;
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return bool(out);
+}
+
+bool profiler::write_csv(const string &file)
+{
+	ofstream out(file);
+	if (!out)
+		return false;
+	lock_guard<mutex> guard(records_lock);
+	// Timers that never ran in an iteration are left empty
+	map<string, int> columns;
+	for (const profile_row &r : rows)
+		for (const auto &t : r.ms)
+			columns[t.first] = 0;
+	out << "iteration,end_ms";
+	for (const auto &c : columns)
+		out << "," << c.first << "_ms";
+	for (int c = 0; c < profile_counter_count; c++)
+		out << "," << counter_names[c];
+	out << "\n";
+	for (int i = 0; i < rows.size(); i++)
+	{
+		const profile_row &r = rows[i];
+		out << i << "," << r.end / 1000.0;
+		for (const auto &c : columns)
+		{
+			out << ",";
+			auto t = r.ms.find(c.first);
+			if (t != r.ms.end())
+				out << t->second;
+		}
+		for (int c = 0; c < profile_counter_count; c++)
+			out << "," << r.counts[c];
+		out << "\n";
+	}
+	return bool(out);
+}
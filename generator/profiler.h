@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Things counted by the profiler
+enum profile_counter
+{
+	nearest_queries, // Closest node searches for attraction points
+	nodes_added,
+	points_killed,
+	meshes_created,
+	draw_calls,
+	profile_counter_count
+};
+
+// Process wide scoped timers and counters. Off by default and switched on and off while running. When off, a timer or counter
+// costs one relaxed atomic load. Timers from every thread go into one trace; counters and timer totals are also cut into rows,
+// one per end_iteration call, which only makes sense while a single tree is growing
+class profiler
+{
+public:
+	// Starting clears everything recorded before
+	static void enable(bool state);
+
+	static bool enabled()
+	{
+		return on.load(std::memory_order_relaxed);
+	}
+
+	static void count(profile_counter c, int64_t n = 1)
+	{
+		if (enabled())
+			counters[c].fetch_add(n, std::memory_order_relaxed);
+	}
+
+	// Records a finished timer, times in microseconds since the profiler was enabled
+	static void record(const char *name, int64_t begin, int64_t end);
+
+	// Closes the current row of the per-iteration table
+	static void end_iteration();
+
+	// Microseconds since the profiler was enabled
+	static int64_t now();
+
+	// Writes the timers as Chrome trace events, with the counters of every iteration as counter events
+	static bool write_trace(const std::string &file);
+
+	// Writes one line per iteration with the time spent in every timer in milliseconds and the counts added in it
+	static bool write_csv(const std::string &file);
+
+private:
+	static std::atomic<bool> on;
+	static std::atomic<int64_t> counters[profile_counter_count];
+
+	// Adds a row with the timer totals and counts since the last one. Needs the records lock
+	static void add_row(int64_t end);
+};
+
+// Times its own lifetime under the given name, which must outlive the profiler's records, such as a string literal
+class scoped_timer
+{
+public:
+	scoped_timer(const char *name) : name(name), begin(profiler::enabled() ? profiler::now() : -1) {}
+
+	~scoped_timer()
+	{
+		if (begin >= 0 && profiler::enabled())
+			profiler::record(name, begin, profiler::now());
+	}
+
+private:
+	const char *name;
+	int64_t begin;
+};
@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+thread_pool::thread_pool(int threads)
+{
+	if (threads <= 0)
+		threads = thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+	next_queue = 0;
+	for (int i = 0; i < threads; i++)
+		queues.push_back(unique_ptr<task_queue>(new task_queue()));
+	for (int i = 0; i < threads; i++)
+		workers.push_back(thread(&thread_pool::run, this, i));
+}
+
+thread_pool::~thread_pool()
+{
+	wait();
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (thread &w : workers)
+		w.join();
+}
+
+void thread_pool::submit(const task &t)
+{
+	task_queue &q = *queues[next_queue++ % queues.size()];
+	{
+		lock_guard<mutex> guard(q.lock);
+		q.tasks.push_back(t);
+	}
+	{
+		lock_guard<mutex> guard(lock);
+		queued++;
+		unfinished++;
+	}
+	wake.notify_one();
+}
+
+void thread_pool::wait()
+{
+	unique_lock<mutex> guard(lock);
+	idle.wait(guard, [this] { return unfinished == 0; });
+}
+
+bool thread_pool::take(int worker, task &t)
+{
+	{
+		task_queue &own = *queues[worker];
+		lock_guard<mutex> guard(own.lock);
+		if (own.tasks.size() > 0)
+		{
+			t = own.tasks.back();
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+	for (int i = 1; i < queues.size(); i++)
+	{
+		task_queue &other = *queues[(worker + i) % queues.size()];
+		lock_guard<mutex> guard(other.lock);
+		if (other.tasks.size() > 0)
+		{
+			t = other.tasks.front();
+			other.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void thread_pool::run(int worker)
+{
+	task t;
+	while (true)
+	{
+		// Claims a task before taking it, so other workers never search the queues for a task that is already spoken for.
+		// Tasks are pushed before queued is raised, so there are always at least as many tasks in the queues as unclaimed counts
+		{
+			unique_lock<mutex> guard(lock);
+			wake.wait(guard, [this] { return queued > 0 || stopping; });
+			if (queued == 0)
+				return;
+			queued--;
+		}
+		while (!take(worker, t))
+			this_thread::yield();
+		t(worker);
+		t = nullptr;
+		lock_guard<mutex> guard(lock);
+		if (--unfinished == 0)
+			idle.notify_all();
+	}
+}
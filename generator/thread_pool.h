@@ -0,0 +1,59 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+
+// Fixed set of worker threads with one task queue each. Workers take their newest task first and steal the oldest task of
+// another worker when their own queue is empty, so uneven tasks still keep every thread busy
+class thread_pool
+{
+public:
+	// Tasks are given the index of the worker running them, in [0, size())
+	typedef std::function<void(int)> task;
+
+	// Starts the workers. threads of 0 uses every core
+	thread_pool(int threads);
+
+	// Finishes every queued task and stops the workers
+	~thread_pool();
+
+	// Returns the number of workers
+	int size() const
+	{
+		return workers.size();
+	}
+
+	// Queues a task. Tasks are spread over the workers' queues in turn
+	void submit(const task &t);
+
+	// Blocks until every submitted task has finished
+	void wait();
+
+private:
+	struct task_queue
+	{
+		std::mutex lock;
+		std::deque<task> tasks;
+	};
+
+	std::vector<std::unique_ptr<task_queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<unsigned> next_queue;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	int queued = 0; // Tasks in a queue that no worker has claimed yet
+	int unfinished = 0; // Tasks submitted but not finished
+	bool stopping = false;
+
+	// Takes a task from the worker's own queue or steals one from another queue. Only called after claiming one from queued
+	bool take(int worker, task &t);
+
+	void run(int worker);
+};
@@ -0,0 +1,90 @@
+#include "tree_cache.h"
+#include "tree_file.h"
+#include "fnv_hash.h"
+#include <cstdio>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+// Changing this invalidates every cached tree
+static const uint32_t cache_version = 4;
+
+static long process_id()
+{
+#ifdef _WIN32
+	return _getpid();
+#else
+	return getpid();
+#endif
+}
+
+uint64_t tree_key(const tree_parameters &params, uint64_t seed)
+{
+	fnv_hash hash;
+	hash.add(cache_version);
+	hash.add(params.no_points);
+	hash.add(params.dp);
+	hash.add(params.ri);
+	hash.add(params.dk);
+	hash.add(params.max_error);
+	hash.add(int32_t(params.tropism));
+	hash.add(uint32_t(params.envelope_curve.size()));
+	for (const vec2 &p : params.envelope_curve)
+	{
+		hash.add(p.x);
+		hash.add(p.y);
+	}
+	hash.add(seed);
+	return hash.value;
+}
+
+string tree_cache::path(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tree", (unsigned long long)key);
+	return dir + "/" + name;
+}
+
+bool tree_cache::load(uint64_t key, node_tree &nodes, vector<float> &radii) const
+{
+	tree_file file;
+	if (!file.open(path(key)) || file.trees.size() != 1 || file.trees[0].key != key)
+		return false;
+	return file.trees[0].to_nodes(nodes, radii);
+}
+
+bool tree_cache::store(uint64_t key, const node_tree &nodes, const vector<float> &radii) const
+{
+	string file = path(key);
+	// Unique to the writing thread, also between processes sharing the cache
+	string temp = file + "." + to_string(process_id()) + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+	tree_file_writer writer;
+	bool ok = writer.open(temp);
+	ok = ok && writer.add(nodes, radii, key);
+	ok = writer.close() && ok;
+	if (!ok)
+	{
+		remove(temp.c_str());
+		return false;
+	}
+	// Renaming over an existing file fails on Windows. Another writer may have stored the same tree first, so that file is
+	// replaced. Any other failure leaves the cached file alone
+	if (rename(temp.c_str(), file.c_str()) != 0)
+	{
+		FILE *existing = fopen(file.c_str(), "rb");
+		if (existing != nullptr)
+			fclose(existing);
+		if (existing == nullptr || remove(file.c_str()) != 0 || rename(temp.c_str(), file.c_str()) != 0)
+		{
+			remove(temp.c_str());
+			return false;
+		}
+	}
+	return true;
+}
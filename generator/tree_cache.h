@@ -0,0 +1,27 @@
+#pragma once
+#include "tree_generator.h"
+#include <string>
+
+// Returns a hash of everything that decides the shape of a tree: the growth and simplification parameters other than threads, and the seed
+uint64_t tree_key(const tree_parameters &params, uint64_t seed);
+
+// On-disk cache of finished trees, addressed by tree_key. Each tree is a tree file holding just that tree, stored with its key.
+// Files are written under a temporary name and renamed into place, so readers never see a partial tree
+struct tree_cache
+{
+	std::string dir;
+
+	tree_cache(const std::string &dir)
+	{
+		this->dir = dir;
+	}
+
+	// Returns the file a tree is stored in
+	std::string path(uint64_t key) const;
+
+	// Maps a cached tree and copies it into nodes and radii, indexed by the new node ids. Returns false if it is not cached or the file is damaged
+	bool load(uint64_t key, node_tree &nodes, std::vector<float> &radii) const;
+
+	// Stores the live nodes of a tree with their radii, indexed by node id. Returns false if the file could not be written
+	bool store(uint64_t key, const node_tree &nodes, const std::vector<float> &radii) const;
+};
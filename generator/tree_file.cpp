@@ -0,0 +1,187 @@
+#include "tree_file.h"
+#include <cstring>
+
+using namespace std;
+using namespace glm;
+
+static_assert(sizeof(vec3) == 3 * sizeof(float), "tree files store positions as packed floats");
+
+namespace
+{
+	const char magic[4] = { 'P', 'T', 'R', 'F' };
+	const uint32_t version = 1;
+	const size_t header_size = 8;
+	const size_t entry_size = 24;
+	const size_t footer_size = 16;
+
+	bool little_endian()
+	{
+		uint32_t one = 1;
+		char first;
+		memcpy(&first, &one, 1);
+		return first == 1;
+	}
+
+	// Reads a little-endian unsigned integer of the given number of bytes
+	uint64_t read_le(const char *p, int bytes)
+	{
+		uint64_t v = 0;
+		for (int i = bytes - 1; i >= 0; i--)
+			v = (v << 8) | uint8_t(p[i]);
+		return v;
+	}
+
+	// Appends a little-endian unsigned integer of the given number of bytes
+	void append_le(vector<char> &buffer, uint64_t v, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			buffer.push_back(char((v >> (i * 8)) & 0xFF));
+	}
+}
+
+bool tree_view::valid() const
+{
+	if (count == 0 || parent[0] != -1)
+		return false;
+	for (uint32_t i = 1; i < count; i++)
+		if (parent[i] < 0 || parent[i] >= int32_t(i))
+			return false;
+	return true;
+}
+
+bool tree_view::to_nodes(node_tree &nodes, vector<float> &radii) const
+{
+	nodes.clear();
+	radii.clear();
+	if (!valid())
+		return false;
+	radii.assign(radius, radius + count);
+	for (uint32_t i = 0; i < count; i++)
+		nodes.add(pos[i], parent[i]);
+	return true;
+}
+
+flat_tree::flat_tree(const node_tree &nodes, const vector<float> &radii)
+{
+	// Removed nodes are dropped, so the live nodes are renumbered in id order
+	vector<int> rank(nodes.ids(), -1);
+	for (int id = 0; id < nodes.ids(); id++)
+	{
+		if (nodes.removed[id])
+			continue;
+		rank[id] = pos.size();
+		pos.push_back(nodes.pos[id]);
+		parent.push_back(nodes.parent[id] == -1 ? -1 : rank[nodes.parent[id]]);
+		radius.push_back(radii[id]);
+	}
+}
+
+tree_view flat_tree::view(uint64_t key) const
+{
+	tree_view v;
+	v.pos = pos.data();
+	v.parent = parent.data();
+	v.radius = radius.data();
+	v.count = pos.size();
+	v.key = key;
+	return v;
+}
+
+bool tree_file::open(const string &path)
+{
+	trees.clear();
+	file = mapped_file(path);
+	if (!file.is_open() || !little_endian() || file.size < header_size + footer_size || memcmp(file.data, magic, 4) != 0 || read_le(file.data + 4, 4) != version)
+		return false;
+	const char *footer = file.data + file.size - footer_size;
+	uint64_t table = read_le(footer, 8);
+	uint64_t count = read_le(footer + 8, 4);
+	if (memcmp(footer + 12, magic, 4) != 0 || table < header_size || table > file.size - footer_size || (file.size - footer_size - table) / entry_size < count)
+		return false;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		const char *e = file.data + table + i * entry_size;
+		uint64_t offset = read_le(e, 8);
+		tree_view view;
+		view.key = read_le(e + 8, 8);
+		view.count = uint32_t(read_le(e + 16, 4));
+		uint64_t bytes = uint64_t(view.count) * (sizeof(vec3) + sizeof(int32_t) + sizeof(float));
+		if (offset < header_size || offset % 4 != 0 || offset > table || bytes > table - offset || view.count == 0)
+		{
+			trees.clear();
+			return false;
+		}
+		view.pos = reinterpret_cast<const vec3*>(file.data + offset);
+		view.parent = reinterpret_cast<const int32_t*>(file.data + offset + view.count * sizeof(vec3));
+		view.radius = reinterpret_cast<const float*>(file.data + offset + view.count * (sizeof(vec3) + sizeof(int32_t)));
+		trees.push_back(view);
+	}
+	return true;
+}
+
+bool tree_file_writer::open(const string &path)
+{
+	out.open(path, ios::binary | ios::trunc);
+	written = 0;
+	table.clear();
+	vector<char> header(magic, magic + 4);
+	append_le(header, version, 4);
+	out.write(header.data(), header.size());
+	written += header.size();
+	return bool(out);
+}
+
+void tree_file_writer::write_words(const void *words, size_t count)
+{
+	if (little_endian())
+		out.write(static_cast<const char*>(words), count * 4);
+	else
+	{
+		vector<char> buffer;
+		buffer.reserve(count * 4);
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t w;
+			memcpy(&w, static_cast<const char*>(words) + i * 4, 4);
+			append_le(buffer, w, 4);
+		}
+		out.write(buffer.data(), buffer.size());
+	}
+	written += count * 4;
+}
+
+bool tree_file_writer::add(const node_tree &nodes, const vector<float> &radii, uint64_t key)
+{
+	flat_tree flat(nodes, radii);
+	entry e;
+	e.offset = written;
+	e.key = key;
+	e.count = flat.pos.size();
+	table.push_back(e);
+	write_words(flat.pos.data(), flat.pos.size() * 3);
+	write_words(flat.parent.data(), flat.parent.size());
+	write_words(flat.radius.data(), flat.radius.size());
+	return bool(out);
+}
+
+bool tree_file_writer::close()
+{
+	vector<char> tail;
+	while ((written + tail.size()) % 8 != 0)
+		tail.push_back(0);
+	uint64_t table_offset = written + tail.size();
+	for (const entry &e : table)
+	{
+		append_le(tail, e.offset, 8);
+		append_le(tail, e.key, 8);
+		append_le(tail, e.count, 4);
+		append_le(tail, 0, 4);
+	}
+	append_le(tail, table_offset, 8);
+	append_le(tail, table.size(), 4);
+	tail.insert(tail.end(), magic, magic + 4);
+	out.write(tail.data(), tail.size());
+	written += tail.size();
+	out.close();
+	return bool(out);
+}
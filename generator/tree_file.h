@@ -0,0 +1,86 @@
+#pragma once
+#include "node_tree.h"
+#include "mapped_file.h"
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+// Tree files hold any number of trees in a versioned little-endian format. All offsets are in bytes from the start of the file.
+//   Header:    char magic[4] = "PTRF", uint32 version = 1
+//   Each tree: float pos[3 * count], int32 parent[count], float radius[count]
+//              The live nodes of a node_tree numbered in id order, so a parent always comes before its children. The root's parent is -1
+//   Table:     at an 8 byte aligned offset, one entry per tree of uint64 offset, uint64 key, uint32 count, uint32 reserved = 0
+//   Footer:    uint64 table offset, uint32 tree count, char magic[4] = "PTRF"
+// The table comes last so trees can be written one at a time as they are finished
+
+// Read only view of one tree in a mapped tree file. The arrays point straight into the mapping, so nothing is copied
+struct tree_view
+{
+	const glm::vec3 *pos;
+	const int32_t *parent;
+	const float *radius;
+	uint32_t count;
+	uint64_t key; // Whatever the writer stored, tree_key for cached trees
+
+	// Returns true if the tree has a root with parent -1 and every other parent is the index of a node before it. Reads every parent index,
+	// so callers that trust the file can skip it
+	bool valid() const;
+
+	// Copies the tree into a node_tree and its radii, indexed by the new node ids. Returns false if the tree is not valid
+	bool to_nodes(node_tree &nodes, std::vector<float> &radii) const;
+};
+
+// The live nodes of a node_tree numbered in id order, held in the same arrays as a tree file
+struct flat_tree
+{
+	std::vector<glm::vec3> pos;
+	std::vector<int32_t> parent;
+	std::vector<float> radius;
+
+	flat_tree() {}
+
+	// Copies the live nodes of a tree with their radii, indexed by node id
+	flat_tree(const node_tree &nodes, const std::vector<float> &radii);
+
+	// Returns a view of the arrays, valid while this flat_tree is unchanged
+	tree_view view(uint64_t key = 0) const;
+};
+
+// A tree file mapped into memory. Opening only reads the header, footer and table, node data is paged in when it is used
+struct tree_file
+{
+	mapped_file file;
+	std::vector<tree_view> trees;
+
+	// Maps a tree file and checks its structure. Returns false if it cannot be mapped, is damaged, has another version,
+	// or the machine is big-endian, where the arrays cannot be used in place
+	bool open(const std::string &path);
+};
+
+// Writes trees into a tree file with sequential writes only. The file is incomplete until close has written the table
+struct tree_file_writer
+{
+	// Creates the file and writes the header. Returns false if it cannot be created
+	bool open(const std::string &path);
+
+	// Writes the live nodes of a tree with their radii, indexed by node id
+	bool add(const node_tree &nodes, const std::vector<float> &radii, uint64_t key);
+
+	// Writes the table and footer and closes the file. Returns false if anything failed to write
+	bool close();
+
+private:
+	struct entry
+	{
+		uint64_t offset;
+		uint64_t key;
+		uint32_t count;
+	};
+
+	std::ofstream out;
+	uint64_t written = 0;
+	std::vector<entry> table;
+
+	// Writes values as little-endian 32-bit words
+	void write_words(const void *words, size_t count);
+};
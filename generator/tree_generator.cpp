@@ -0,0 +1,235 @@
+#include "tree_generator.h"
+#include "parallel.h"
+#include "profiler.h"
+#include <chrono>
+
+using namespace std;
+using namespace glm;
+
+// Milliseconds since an earlier time point
+static double ms_since(const chrono::steady_clock::time_point &begin)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+void tree_generator::start(uint64_t seed)
+{
+	times = phase_times();
+	auto begin = chrono::steady_clock::now();
+	{
+		scoped_timer timer("sample");
+		points = populate_envelope(params.envelope_curve, params.no_points, seed, params.threads);
+	}
+	times.sample = ms_since(begin);
+	nodes.clear();
+	nodes.add(vec3(0.0f), -1);
+	// Cells of the radius of influence, split into cells of about the placement distance
+	grid.reset(params.ri, std::max(1, int(round(params.ri / params.dp))));
+	grid.rebuild(nodes);
+	purged_nodes = 0;
+	found_points_yet = false;
+	finished = false;
+	stage = idle;
+	att_segments.clear();
+	next_branch_segments.clear();
+	added_nodes.clear();
+	killed_points.clear();
+}
+
+size_t tree_generator::storage_bytes() const
+{
+	return nodes.storage_bytes() + grid.storage_bytes() + kill_grid.storage_bytes() + (points.capacity() + dir.capacity()) * sizeof(vec3) + (closest.capacity() + added_nodes.capacity() + killed_points.capacity()) * sizeof(int) + killed.capacity();
+}
+
+void tree_generator::begin_pass()
+{
+	att_segments.clear();
+	next_branch_segments.clear();
+	added_nodes.clear();
+	killed_points.clear();
+	if (params.tropism == wind)
+		for (vec3 &p : points)
+			p += vec3(0.04f, 0.0f, 0.0f);
+	times.passes++;
+	pass_size = nodes.size();
+	nodes.clear_attractions();
+	closest.resize(points.size());
+	dir.resize(points.size());
+	next_point = 0;
+	stage = attracting;
+}
+
+void tree_generator::find_closest(int end)
+{
+	scoped_timer timer("attract");
+	auto begin = chrono::steady_clock::now();
+	profiler::count(nearest_queries, end - next_point);
+	int first = next_point;
+	parallel_for(end - first, params.threads, [&](int b, int e)
+	{
+		for (int i = first + b; i < first + e; i++)
+		{
+			closest[i] = grid.closest_node(points[i], params.ri);
+			if (closest[i] != -1)
+				dir[i] = normalize(points[i] - nodes.pos[closest[i]]);
+		}
+	});
+	next_point = end;
+	times.attract += ms_since(begin);
+}
+
+void tree_generator::colonise()
+{
+	auto begin = chrono::steady_clock::now();
+	{
+		scoped_timer timer("attract");
+		// Attractions are summed in point order so the tree is the same whatever the number of threads or slices
+		for (int i = 0; i < points.size(); i++)
+			if (closest[i] != -1)
+			{
+				nodes.att_dir[closest[i]] += dir[i];
+				if (use_debug)
+					att_segments.push_back(pair<vec3, vec3>(points[i], nodes.pos[closest[i]]));
+			}
+		nodes.normalise_attractions();
+	}
+	times.attract += ms_since(begin);
+	if (use_debug)
+		for (int id = 0; id < nodes.ids(); id++)
+			if (nodes.att_dir[id] != vec3(0.0))
+				next_branch_segments.push_back(pair<vec3, vec3>(nodes.pos[id], nodes.pos[id] + nodes.att_dir[id] * params.dp));
+	begin = chrono::steady_clock::now();
+	{
+		scoped_timer timer("colonise");
+		nodes.colonise_nodes(params.dp, params.tropism, added_nodes);
+		for (int id : added_nodes)
+			grid.insert(id, nodes.pos[id]);
+		// If no nodes are added add one above the last node
+		if (pass_size == nodes.size())
+			if (nodes.pos[nodes.newest()].y > params.envelope_curve[0].y)
+				finished = true;
+			else
+				if (!found_points_yet)
+				{
+					int last = nodes.newest();
+					int id = nodes.add(nodes.pos[last] + vec3(0.0f, params.dp, 0.0f), last);
+					grid.insert(id, nodes.pos[id]);
+					added_nodes.push_back(id);
+				}
+				else
+					finished = true;
+		else
+			found_points_yet = true;
+	}
+	times.colonise += ms_since(begin);
+	profiler::count(nodes_added, added_nodes.size());
+
+	// Only new nodes can have come into kill distance of the points, unless wind has moved them
+	begin = chrono::steady_clock::now();
+	kill_grid.reset(params.dk);
+	for (int id = params.tropism == wind ? 0 : purged_nodes; id < nodes.ids(); id++)
+		if (!nodes.removed[id])
+			kill_grid.insert(id, nodes.pos[id]);
+	purged_nodes = nodes.ids();
+	killed.assign(points.size(), 0);
+	next_point = kill_grid.empty() ? points.size() : 0;
+	stage = purging;
+	times.purge += ms_since(begin);
+}
+
+void tree_generator::find_killed(int end)
+{
+	scoped_timer timer("purge");
+	auto begin = chrono::steady_clock::now();
+	for (int i = next_point; i < end; i++)
+		killed[i] = kill_grid.is_closer_than(points[i], params.dk);
+	next_point = end;
+	times.purge += ms_since(begin);
+}
+
+void tree_generator::end_pass()
+{
+	scoped_timer timer("purge");
+	auto begin = chrono::steady_clock::now();
+	int kept = 0;
+	for (int i = 0; i < points.size(); i++)
+		if (killed[i])
+			killed_points.push_back(i);
+		else
+			points[kept++] = points[i];
+	points.resize(kept);
+	profiler::count(points_killed, killed_points.size());
+	stage = idle;
+	times.purge += ms_since(begin);
+	profiler::end_iteration();
+}
+
+void tree_generator::single_pass()
+{
+	if (stage == idle)
+	{
+		if (points.size() == 0)
+		{
+			att_segments.clear();
+			next_branch_segments.clear();
+			added_nodes.clear();
+			killed_points.clear();
+			return;
+		}
+		begin_pass();
+	}
+	// Finishes a pass started by grow_slice in one go
+	if (stage == attracting)
+	{
+		find_closest(points.size());
+		colonise();
+	}
+	find_killed(points.size());
+	end_pass();
+}
+
+bool tree_generator::grow_slice(double budget_ms)
+{
+	auto begin = chrono::steady_clock::now();
+	if (stage == idle)
+	{
+		if (finished || points.size() == 0)
+			return false;
+		begin_pass();
+	}
+	// Always takes at least one step, so every call makes progress however small the budget
+	do
+	{
+		if (stage == attracting)
+		{
+			if (next_point < points.size())
+				find_closest(std::min(next_point + slice_points, int(points.size())));
+			else
+				colonise();
+		}
+		else if (next_point < points.size())
+			find_killed(std::min(next_point + slice_points, int(points.size())));
+		else
+		{
+			end_pass();
+			return true;
+		}
+	} while (ms_since(begin) < budget_ms);
+	return false;
+}
+
+void tree_generator::grow()
+{
+	while (!finished && points.size() > 0)
+		single_pass();
+}
+
+int tree_generator::simplify()
+{
+	scoped_timer timer("simplify");
+	auto begin = chrono::steady_clock::now();
+	int removed = nodes.simplify(params.max_error);
+	grid.rebuild(nodes);
+	times.simplify += ms_since(begin);
+	return removed;
+}
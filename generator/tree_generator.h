@@ -0,0 +1,130 @@
+#pragma once
+#include "node_tree.h"
+#include "node_grid.h"
+#include "envelope.h"
+#include "tropism.h"
+#include <cstdint>
+
+// Parameters controlling the growth of a tree
+struct tree_parameters
+{
+	uint32_t no_points = 3000; // Number of attraction points
+	float dp = 0.1f; // Node placement distance
+	float ri = 1.0f; // Radius of influence
+	float dk = 0.16f; // Attraction point kill distance
+	tropisms tropism = none;
+	std::vector<glm::vec2> envelope_curve = default_envelope_curve();
+	float max_error = 0.01f; // Furthest simplify may move the skeleton from where it grew
+	int threads = 0; // Threads used to find the closest nodes, 0 for every core
+};
+
+// Wall time spent in each phase of growing a tree, in milliseconds
+struct phase_times
+{
+	double sample = 0.0; // Filling the envelope with attraction points
+	double attract = 0.0; // Finding the closest node of every point and summing the attractions
+	double colonise = 0.0; // Adding new nodes
+	double purge = 0.0; // Removing points within kill distance
+	double simplify = 0.0;
+	int passes = 0;
+};
+
+// Grows one tree with the space colonisation algorithm. Generators share no state, so any number can run in parallel threads.
+// Reproducibility: the same parameters and seed give the same tree, node for node, whatever the number of threads, in the same
+// build of the library. Attraction points come from per point counter_rng streams and every sum runs in point order, so nothing
+// depends on scheduling. Different compilers, flags or maths libraries may round differently and grow different trees
+struct tree_generator
+{
+	tree_parameters params;
+	node_tree nodes;
+	std::vector<glm::vec3> points; // Attraction points still alive
+	bool finished = false;
+
+	// Changes made by the last pass, so a view of the tree can be updated without scanning all of it
+	std::vector<int> added_nodes; // Ids of new nodes, each one the end of a new segment from its parent
+	std::vector<int> killed_points; // Indices the removed points had in points before the pass, in increasing order
+
+	// Time spent since start
+	phase_times times;
+
+	// Debug output of the last pass, only filled in when use_debug is set
+	bool use_debug = false;
+	std::vector<std::pair<glm::vec3, glm::vec3>> att_segments;
+	std::vector<std::pair<glm::vec3, glm::vec3>> next_branch_segments;
+
+	tree_generator() {}
+
+	tree_generator(const tree_parameters &params)
+	{
+		this->params = params;
+	}
+
+	// Fills the envelope with attraction points drawn from the seed and clears the tree down to a root node. The storage of the
+	// last tree is kept, so a generator that is started again for every tree stops allocating once it has grown the largest one
+	void start(uint64_t seed);
+
+	// Returns the bytes of storage held for the tree and its points, used or not. Debug output is not counted
+	size_t storage_bytes() const;
+
+	// Does a single iteration of the algorithm, or the rest of one started by grow_slice
+	void single_pass();
+
+	// Works on the current pass, starting one if needed, until about budget_ms have passed. Points are handled slice_points at a
+	// time, so a call overruns the budget by at most one slice. Returns true when a pass was completed, which always ends the call.
+	// Growing in slices gives the same tree as single_pass. Between calls a pass may be half done: nodes can hold the new nodes
+	// while points still holds the points they will kill, so the tree should only be read after a call returning true
+	bool grow_slice(double budget_ms);
+
+	// Returns whether a pass started by grow_slice is unfinished
+	bool in_pass() const
+	{
+		return stage != idle;
+	}
+
+	// Runs passes until the tree is finished or the points run out
+	void grow();
+
+	// Removes nodes from straight runs of branches within params.max_error, see node_tree::simplify. Returns the number of nodes removed
+	int simplify();
+
+	// Attraction points handled per step of grow_slice
+	int slice_points = 4096;
+
+private:
+	// Steps of a pass
+	enum pass_stage
+	{
+		idle,
+		attracting, // Finding the closest node of every point
+		purging // Finding the points within kill distance of the new nodes
+	};
+
+	node_grid grid;
+	int purged_nodes = 0; // Nodes with a lower id have already been checked against the attraction points
+	bool found_points_yet = false;
+
+	// State of the pass in progress
+	pass_stage stage = idle;
+	int pass_size = 0; // Nodes in the tree when the pass started
+	int next_point = 0; // First point the current stage has not handled yet
+	std::vector<int> closest; // Closest node within the radius of influence of every point, or -1
+	std::vector<glm::vec3> dir; // Direction from the closest node to every point
+	node_grid kill_grid; // Nodes the points have not been checked against yet
+	std::vector<uint8_t> killed;
+
+	// Clears the outputs of the last pass and starts a new one
+	void begin_pass();
+
+	// Finds the closest nodes of points up to end in parallel
+	void find_closest(int end);
+
+	// Sums the attractions in point order, so the tree is the same whatever the number of threads or slices, then grows new nodes
+	// and starts the purge
+	void colonise();
+
+	// Marks the points up to end that are within kill distance of a new node
+	void find_killed(int end);
+
+	// Removes the marked points, records them in killed_points and finishes the pass
+	void end_pass();
+};
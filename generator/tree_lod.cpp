@@ -0,0 +1,103 @@
+#include "tree_lod.h"
+#include "profiler.h"
+#include <lib/glm/glm/gtc/constants.hpp>
+#include <cfloat>
+
+using namespace std;
+using namespace glm;
+
+// Adds a quad with the given corners, facing both ways
+static void add_double_quad(mesh_data &m, const vec3 &a, const vec3 &b, const vec3 &c, const vec3 &d, const vec3 &normal)
+{
+	for (int face = 0; face < 2; face++)
+	{
+		uint32_t first = m.positions.size();
+		vec3 corners[4] = { a, b, c, d };
+		for (const vec3 &p : corners)
+		{
+			m.positions.push_back(p);
+			m.normals.push_back(face == 0 ? normal : -normal);
+		}
+		uint32_t front[6] = { 0, 1, 2, 0, 2, 3 };
+		uint32_t back[6] = { 0, 2, 1, 0, 3, 2 };
+		for (int i = 0; i < 6; i++)
+			m.indices.push_back(first + (face == 0 ? front[i] : back[i]));
+	}
+}
+
+// Makes two crossed vertical silhouettes through the root, as wide at each height as the tree is there
+static mesh_data impostor(const node_tree &nodes, const vector<float> &radii)
+{
+	const int bands = 8;
+	float bottom = FLT_MAX;
+	float top = -FLT_MAX;
+	for (int id = 0; id < nodes.ids(); id++)
+		if (!nodes.removed[id])
+		{
+			bottom = glm::min(bottom, nodes.pos[id].y);
+			top = glm::max(top, nodes.pos[id].y);
+		}
+	float height = glm::max(top - bottom, 0.001f);
+	// Widest reach from the trunk's axis within each band of height
+	vector<float> width(bands, 0.0f);
+	vec3 root = nodes.pos[0];
+	for (int id = 0; id < nodes.ids(); id++)
+		if (!nodes.removed[id])
+		{
+			int band = glm::min(int((nodes.pos[id].y - bottom) / height * bands), bands - 1);
+			float reach = length(vec2(nodes.pos[id].x - root.x, nodes.pos[id].z - root.z)) + radii[id];
+			width[band] = glm::max(width[band], reach);
+		}
+
+	mesh_data m;
+	vec3 across[2] = { vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f) };
+	for (int plane = 0; plane < 2; plane++)
+	{
+		vec3 normal = cross(across[plane], vec3(0.0f, 1.0f, 0.0f));
+		for (int b = 0; b < bands; b++)
+		{
+			// Each band spans from its own width at the bottom to the next band's at the top
+			float w0 = width[b];
+			float w1 = b + 1 < bands ? width[b + 1] : 0.0f;
+			vec3 y0 = vec3(root.x, bottom + height * b / bands, root.z);
+			vec3 y1 = vec3(root.x, bottom + height * (b + 1) / bands, root.z);
+			add_double_quad(m, y0 - across[plane] * w0, y0 + across[plane] * w0, y1 + across[plane] * w1, y1 - across[plane] * w1, normal);
+		}
+	}
+	return m;
+}
+
+tree_lod make_lod_chain(const node_tree &nodes, int sides)
+{
+	scoped_timer timer("make_lod_chain");
+	tree_lod lod;
+	vector<float> radii = nodes.pipe_radii();
+	lod.levels.push_back(body_mesh(nodes, radii, sides));
+	lod.levels.push_back(body_mesh(nodes, radii, glm::max(sides / 2, 3)));
+	float height = 0.0f;
+	for (int id = 0; id < nodes.ids(); id++)
+		if (!nodes.removed[id])
+			height = glm::max(height, nodes.pos[id].y - nodes.pos[0].y);
+	height = glm::max(height, 1.0f);
+
+	// Allowing the skeleton to move by half a percent of the tree's height leaves the main shape with far fewer rings
+	node_tree skeleton = nodes;
+	skeleton.simplify(height * 0.005f);
+	lod.levels.push_back(body_mesh(skeleton, skeleton.pipe_radii(), 3));
+	lod.levels.push_back(impostor(nodes, radii));
+	profiler::count(meshes_created);
+
+	lod.distances.push_back(0.0f);
+	lod.distances.push_back(height * 4.0f);
+	lod.distances.push_back(height * 10.0f);
+	lod.distances.push_back(height * 25.0f);
+	return lod;
+}
+
+int select_lod(const tree_lod &lod, float distance)
+{
+	int level = 0;
+	while (level + 1 < lod.distances.size() && distance >= lod.distances[level + 1])
+		level++;
+	return level;
+}
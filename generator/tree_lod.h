@@ -0,0 +1,18 @@
+#pragma once
+#include "mesh_data.h"
+
+// Levels of detail of one tree, from the full body down to an impostor. A renderer keeps one mesh per level and picks one per tree per frame
+struct tree_lod
+{
+	// 0: the full body, 1: the body with fewer ring sides, 2: a more simplified skeleton with the fewest sides,
+	// 3: an impostor of two crossed silhouettes following the outline of the tree
+	std::vector<mesh_data> levels;
+	std::vector<float> distances; // Camera distance from which each level is used, increasing, starting at 0
+};
+
+// Makes the level of detail chain of a tree with rings of the given sides for the full body.
+// Switching distances are multiples of the tree's height, so they suit trees of any size
+tree_lod make_lod_chain(const node_tree &nodes, int sides);
+
+// Returns the level to draw a tree with at a distance from the camera
+int select_lod(const tree_lod &lod, float distance);
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+
+// Passes values from one writer thread to one reader thread without locks. The writer fills its own buffer and swaps it with the
+// spare one, and the reader swaps the spare one for its own when it holds something newer, so neither ever waits or sees a
+// buffer being written. Values in the buffers are reused, so containers keep their capacity from one write to the next
+template<typename T>
+class triple_buffer
+{
+public:
+	triple_buffer() : spare(1) {}
+
+	// Buffer for the writer to fill. It holds whatever was written into it three publishes ago, or nothing
+	T &write()
+	{
+		return buffers[back];
+	}
+
+	// Hands the written buffer to the reader
+	void publish()
+	{
+		back = spare.exchange(back | fresh, std::memory_order_acq_rel) & index;
+	}
+
+	// Takes the newest published value if there is one the reader has not seen. Returns whether read() changed
+	bool update()
+	{
+		if (!(spare.load(std::memory_order_relaxed) & fresh))
+			return false;
+		front = spare.exchange(front, std::memory_order_acq_rel) & index;
+		return true;
+	}
+
+	// The newest value taken by update. Stays the same until the next update
+	const T &read() const
+	{
+		return buffers[front];
+	}
+
+private:
+	static const int index = 3;
+	static const int fresh = 4; // Set on the spare buffer's index when it was published after the reader last took one
+
+	T buffers[3];
+	int front = 0; // Only used by the reader
+	int back = 2; // Only used by the writer
+	std::atomic<int> spare;
+};
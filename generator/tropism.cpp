@@ -0,0 +1,36 @@
+#include "tropism.h"
+
+using namespace glm;
+
+vec3 apply_tropism(tropisms tropism, vec3 n, vec3 pos)
+{
+	switch (tropism)
+	{
+	case none:
+		return n;
+		break;
+	case gravity:
+		return normalize(n + vec3(0.0f, -0.6f, 0.0f));
+		break;
+	case attract:
+		if (pos.x + pos.z != 0)
+		{
+			vec3 core = vec3(0.0f, pos.y, 0.0f);
+			return normalize(normalize(core - pos) * 1.0f + n);
+		}
+		return n;
+		break;
+	case spin:
+		if (pos.x + pos.z != 0)
+		{
+			vec3 core = vec3(0.0f, pos.y, 0.0f);
+			vec3 perp = normalize(cross(vec3(0.0f, 1.0f, 0.0f), pos - core));
+			return normalize((perp * 1.0f) * dot(n, pos - core) + n);
+		}
+		return n;
+		break;
+	default:
+		return n;
+		break;
+	}
+}
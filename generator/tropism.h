@@ -0,0 +1,14 @@
+#pragma once
+#include <lib/glm/glm/glm.hpp>
+
+enum tropisms
+{
+	none,
+	gravity,
+	wind,
+	attract,
+	spin
+};
+
+// Applies the effect of a tropism to growth direction n of the node at pos
+glm::vec3 apply_tropism(tropisms tropism, glm::vec3 n, glm::vec3 pos);
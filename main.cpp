@@ -2,252 +2,194 @@
 #include <graphics_framework.h>
 #include <thread>
 #include <iostream>
+#include <algorithm>
+#include "generator/growth_worker.h"
+#include "generator/mesh_data.h"
+#include "generator/mesh_export.h"
+#include "generator/tree_lod.h"
+#include "generator/profiler.h"
 
 
 using namespace std;
 using namespace graphics_framework;
 using namespace glm;
 
-// Applies the effect of a tropism defined in this function
-vec3 apply_tropism(vec3 n, vec3 pos);
-
-struct node
-{
-	vec3 pos;
-	vec3 att_dir = vec3(0.0f); // Attraction direction
-	vector<node*> children;
+effect eff_red;
+effect eff_green;
+effect eff_blue;
+effect eff_lambert;
+effect eff_mask;
+free_camera cam;
 
+map<string, texture> masks;
 
-	node(vec3 pos)
-	{
-		this->pos = pos;
-	}
+// Cursor position
+double cursor_x;
+double cursor_y;
 
-	// Gets a node based on a number of iterations needed to reach it. !!Does not return the same element if the tree has been modified in any way!!
-	node *get(int i)
-	{
-		int hits = 0;
-		return get(i, hits);
-	}
+geometry screen_quad;
+mesh plane;
+frame_buffer f_buffer;
 
-	// Returns the number of nodes in the tree
-	int size()
-	{
-		int s = 0;
-		return size(s);
-	}
+// Renders a framework mesh or geometry, counting the draw call
+template<typename T>
+void draw(const T &m)
+{
+	renderer::render(m);
+	profiler::count(draw_calls);
+}
 
-private:
-	node *get(int i, int &hits)
-	{
-		if (i == hits)
-			return this;
-		hits++;
-		for (node *n : children)
-		{
-			node *tmp = n->get(i, hits);
-			if (tmp != nullptr)
-				return tmp;
-		}
-		return nullptr;
-	}
+// A mesh_data held in one vertex and index buffer and drawn with a single call. Appended parts are uploaded on their own,
+// and the buffers double in size when full, so a growing tree is only uploaded in full a few times
+struct merged_mesh
+{
+	mesh_data data; // Copy of what is on the GPU, uploaded again when the buffers grow
+	GLuint vao = 0;
+	GLuint buffers[3] = { 0, 0, 0 }; // Positions, normals and indices
+	size_t vertex_capacity = 0;
+	size_t index_capacity = 0;
 
-	int size(int &s)
+	// Replaces the contents with the given mesh
+	void set(const mesh_data &m)
 	{
-		for (node *n : children)
-			n->size(s);
-		return ++s;
+		data = m;
+		upload(0, 0);
 	}
 
-public:
-
-	// Sets all attraction direction points to 0
-	void clear_attractions()
+	// Adds to the contents, only uploading the given mesh if it fits in the buffers
+	void append(const mesh_data &m)
 	{
-		att_dir = vec3(0.0f);
-		for (node *n : children)
-			n->clear_attractions();
+		size_t first_vertex = data.positions.size();
+		size_t first_index = data.indices.size();
+		data.append(m);
+		upload(first_vertex, first_index);
 	}
 
-	// Returns the closest node in the tree
-	node *closest_node(const vec3 &point)
+	void render() const
 	{
-		node *closest = this;
-		for (node *n : children)
-		{
-			node *closest_child = n->closest_node(point);
-			if (length2(point - closest_child->pos) < length2(point - closest->pos))
-				closest = closest_child;
-		}
-		return closest;
+		if (data.indices.size() == 0)
+			return;
+		glBindVertexArray(vao);
+		glDrawElements(GL_TRIANGLES, GLsizei(data.indices.size()), GL_UNSIGNED_INT, nullptr);
+		glBindVertexArray(0);
+		profiler::count(draw_calls);
 	}
 
-	// Normalises all the attraction direction vectors
-	void normalise_attractions()
-	{
-		if (att_dir != vec3(0.0f))
-			att_dir = normalize(att_dir);
-		for (node *n : children)
-			n->normalise_attractions();
+private:
+	// Uploads the vertices and indices from the given ones on, or all of them if the buffers have to grow
+	void upload(size_t first_vertex, size_t first_index)
+	{
+		if (vao == 0)
+		{
+			glGenVertexArrays(1, &vao);
+			glGenBuffers(3, buffers);
+			glBindVertexArray(vao);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+			glVertexAttribPointer(BUFFER_INDEXES::POSITION_BUFFER, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+			glEnableVertexAttribArray(BUFFER_INDEXES::POSITION_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+			glVertexAttribPointer(BUFFER_INDEXES::NORMAL_BUFFER, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+			glEnableVertexAttribArray(BUFFER_INDEXES::NORMAL_BUFFER);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[2]);
+		}
+		glBindVertexArray(vao);
+		size_t vertices = data.positions.size();
+		size_t indices = data.indices.size();
+		if (vertices > vertex_capacity || indices > index_capacity)
+		{
+			vertex_capacity = std::max(vertices * 2, size_t(256));
+			index_capacity = std::max(indices * 2, size_t(256));
+			first_vertex = 0;
+			first_index = 0;
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+			glBufferData(GL_ARRAY_BUFFER, vertex_capacity * sizeof(vec3), nullptr, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+			glBufferData(GL_ARRAY_BUFFER, vertex_capacity * sizeof(vec3), nullptr, GL_DYNAMIC_DRAW);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_capacity * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+		}
+		if (vertices > first_vertex)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+			glBufferSubData(GL_ARRAY_BUFFER, first_vertex * sizeof(vec3), (vertices - first_vertex) * sizeof(vec3), &data.positions[first_vertex]);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+			glBufferSubData(GL_ARRAY_BUFFER, first_vertex * sizeof(vec3), (vertices - first_vertex) * sizeof(vec3), &data.normals[first_vertex]);
+		}
+		if (indices > first_index)
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first_index * sizeof(GLuint), (indices - first_index) * sizeof(GLuint), &data.indices[first_index]);
+		glBindVertexArray(0);
 	}
+};
 
-	// Adds child nodes to nodes that have a non-zero att_dir along that vector at a distance d
-	void colonise_nodes(const float &d)
-	{
-		for (node *n : children)
-			n->colonise_nodes(d);
-		vec3 zero = vec3(0.0f);
-		if (att_dir != zero)
-		{
-			vec3 n = apply_tropism(this->att_dir, this->pos);
-			vec3 branch = pos + (n * d);
-			if (!(children.size() > 0 && children[children.size() - 1]->pos == branch))
-				children.push_back(new node(branch));
-		}
-	}
+// Points in one vertex buffer drawn as GL_POINTS with a single call. The buffer only grows, and is only uploaded to when the
+// points are drawn after changing, so points that are not shown cost nothing
+struct point_cloud
+{
+	vector<vec3> points; // Copy of what is, or is about to be, on the GPU
+	GLuint vao = 0;
+	GLuint buffer = 0;
+	size_t capacity = 0;
+	bool dirty = false;
 
-	// Returns whether or not the node is closer to given point than distance d
-	bool is_closer_than(const vec3 &point, const float &d)
+	void set(const vector<vec3> &p)
 	{
-		if (length2(point - pos) < d * d)
-			return true;
-		for (node *n : children)
-			if (n->is_closer_than(point, d))
-				return true;
-		return false;
+		points = p;
+		dirty = true;
 	}
 
-	// Returns all line segments in between nodes
-	vector<pair<vec3, vec3>> get_segments()
+	void render()
 	{
-		vector<pair<vec3, vec3>> v;
-		get_segments(v);
-		return v;
+		if (dirty)
+			upload();
+		if (points.size() == 0)
+			return;
+		glBindVertexArray(vao);
+		glDrawArrays(GL_POINTS, 0, GLsizei(points.size()));
+		glBindVertexArray(0);
+		profiler::count(draw_calls);
 	}
 
-	void get_segments(vector<pair<vec3, vec3>> &s)
+private:
+	void upload()
 	{
-		for (node *n : children)
+		dirty = false;
+		if (vao == 0)
 		{
-			s.push_back(pair<vec3, vec3>(pos, n->pos));
-			n->get_segments(s);
+			glGenVertexArrays(1, &vao);
+			glGenBuffers(1, &buffer);
+			glBindVertexArray(vao);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glVertexAttribPointer(BUFFER_INDEXES::POSITION_BUFFER, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+			glEnableVertexAttribArray(BUFFER_INDEXES::POSITION_BUFFER);
+			glBindVertexArray(0);
 		}
-	}
-
-	// Reduces the number of nodes by combining nodes with similar direction
-	void reduce()
-	{
-		for (node *n : this->children)
-			n->reduce();
-		if (this->children.size() == 1)
-			if (this->children[0]->children.size() == 1)
-			{
-				vec3 dir1 = normalize(this->children[0]->children[0]->pos - this->pos);
-				vec3 dir2 = normalize(this->children[0]->pos - this->pos);
-				if (dot(dir1, dir2) > 0.98f)
-				{
-					node *n = this->children[0];
-					this->children[0] = this->children[0]->children[0];
-					delete(n);
-				}
-			}
-	}
-
-	// Creates the tree body out of cylinders
-	vector<mesh> create_body()
-	{
-		return create_body_helper().second;
-	}
-
-private:
-	pair<float, vector<mesh>> create_body_helper()
-	{
-		vector<mesh> v;
-		float scale = 0.03f;
-		if (this->children.size() > 0)
-			scale = 0.0f;
-		float k = 2.3f;
-		for (node *n : this->children)
+		if (points.size() == 0)
+			return;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		if (points.size() > capacity)
 		{
-			pair<float, vector<mesh>> v1 = n->create_body_helper();
-			v.insert(v.end(), v1.second.begin(), v1.second.end());
-
-			v.push_back(mesh(geometry_builder().create_cylinder(1, 10)));
-			float l = length(this->pos - n->pos);
-			if (l != 0.0f)
-			{
-				vec3 up = vec3(normalize(n->pos - this->pos));
-				vec3 forward;
-				if (dot(up, vec3(1.0f, 0.0f, 0.0f)) < 1.0f)
-					forward = vec3(normalize(cross(up, vec3(1.0f, 0.0f, 0.0f))));
-				else
-					forward = vec3(normalize(cross(up, vec3(0.0f, 0.0f, 1.0f))));
-				v[v.size() - 1].get_transform().orientation = quatLookAt(forward, up);
-				v[v.size() - 1].get_transform().scale = vec3(v1.first, l, v1.first);
-			}
-			else
-				v[v.size() - 1].get_transform().scale = vec3(v1.first, v1.first, v1.first);
-			v[v.size() - 1].get_transform().position = (this->pos + n->pos) / 2.0f;
-
-			if (this->children.size() > 1)
-				scale += powf(v1.first, k);
-			else
-				scale = v1.first;
+			capacity = std::max(points.size(), size_t(1024));
+			glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(vec3), nullptr, GL_DYNAMIC_DRAW);
 		}
-		if (this->children.size() > 1)
-			scale = pow(scale, 1.0f / k);
-		return pair<float, vector<mesh>>(scale, v);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, points.size() * sizeof(vec3), &points[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 };
 
-
-effect eff_red;
-effect eff_green;
-effect eff_blue;
-effect eff_lambert;
-effect eff_mask;
-free_camera cam;
-
-map<string, texture> masks;
-
-// Cursor position
-double cursor_x;
-double cursor_y;
-
-default_random_engine ran;
-
-geometry screen_quad;
-mesh plane;
-frame_buffer f_buffer;
-
-
-// Algorithm parameters
-uint32_t no_points = 3000; // Number of attraction points
-float dp = 0.1f; // Node placement distance
-float ri = dp * 10.0f;// * dp; // Radius of influence
-float dk = dp * 1.6f;// *dp; // Attraction point kill distance
-bool finished = false;
-
-
-vector<mesh> attraction_points;
+point_cloud attraction_points;
 vector<vec2> envelope_curve;
-vector<vec3> points;
-node *root;
-vector<mesh> tree;
-vector<pair<vec3, vec3>> segments;
+tree_parameters params;
+// Grows the tree on its own thread. The viewer only reads the snapshots it publishes
+growth_worker worker;
+int drawn_layout = 0; // Layout of the snapshot the skeleton was built from
+int drawn_nodes = 0; // Node ids already in the skeleton
+bool use_debug = false;
+merged_mesh tree;
+// Levels of detail of the tree body, drawn instead of the skeleton once built
+tree_lod body_lod;
+vector<merged_mesh> body_levels;
+bool show_body = false;
 vector<pair<vec3, vec3>> envelope_segments;
-vector<mesh> envelope;
-
-enum tropisms
-{
-	none,
-	gravity,
-	wind,
-	attract,
-	spin
-};
-
-tropisms tropism = none;
+merged_mesh envelope;
 
 enum context
 {
@@ -257,13 +199,9 @@ enum context
 };
 
 // Debug variables
-bool use_debug = false;
-vector<pair<vec3, vec3>> att_segments;
-vector<mesh> attractions;
-vector<pair<vec3, vec3>> next_branch_segments;
-vector<mesh> next_branches;
+merged_mesh attractions;
+merged_mesh next_branches;
 
-bool next_frame = true;
 bool no_wait = false;
 context stage = start;
 bool default_envelope = true;
@@ -328,256 +266,14 @@ mat4 calculatePV()
 	return cam.get_projection() * cam.get_view();
 }
 
-// Makes a 2d curve which can later be used to determine if a point is inside the envelope or not. !!Curve should be laid out top to bottom in descending height; all values must be positive!!
-vector<vec2> default_envelope_curve()
-{
-	vector<vec2> curve;
-	curve.push_back(vec2(0.0f, 8.0f));
-	curve.push_back(vec2(0.6f, 7.8f));
-	curve.push_back(vec2(1.2f, 7.4f));
-	curve.push_back(vec2(1.8f, 6.9f));
-	curve.push_back(vec2(2.2f, 6.2f));
-	curve.push_back(vec2(2.5f, 5.3f));
-	curve.push_back(vec2(2.4f, 4.5f));
-	curve.push_back(vec2(2.0f, 4.0f));
-	curve.push_back(vec2(1.7f, 3.5f));
-	curve.push_back(vec2(1.3f, 3.0f));
-	curve.push_back(vec2(0.9f, 2.5f));
-	return curve;
-}
-
-// Makes a segment vector from envelope curve
-vector<pair<vec3, vec3>> curve_to_segments(const vector<vec2> &v)
-{
-	int count = v.size();
-	vector<pair<vec3, vec3>> seg;
-	if (count < 1)
-		return seg;
-	seg.push_back(pair<vec3, vec3>(vec3(0.0f, v[0].y, 0.0f), vec3(v[0].x, v[0].y, 0.0f)));
-	if (count == 1)
-		return seg;
-	for (int i = 0; i < count - 1; i++)
-	{
-		seg.push_back(pair<vec3, vec3>(vec3(v[i].x, v[i].y, 0.0f), vec3(v[i + 1].x, v[i + 1].y, 0.0f)));
-	}
-
-	seg.push_back(pair<vec3, vec3>(vec3(0.0f, v[count - 1].y, 0.0f), vec3(v[count - 1].x, v[count - 1].y, 0.0f)));
-	seg.push_back(pair<vec3, vec3>(seg[0].first, seg[seg.size() - 1].first));
-	return seg;
-}
-
-// Returns true if a point is inside a rotated curve envelope. The curve is rotated around the y axis
-bool inside_rotated_curve(const vec3 &point, const vector<vec2> &curve)
-{
-	// Check if above below curve
-	if (point.y > curve[0].y)
-		return false;
-	if (point.y < curve[curve.size() - 1].y)
-		return false;
-
-	for (int i = 0; i < curve.size() - 1; i++)
-		if (point.y >= curve[i + 1].y)
-		{
-			float d2 = (point.x * point.x) + (point.z * point.z);
-			float alpha = (curve[i].y - point.y) / (curve[i].y - curve[i + 1].y);
-			float cd = (curve[i + 1].x - curve[i].x) * alpha + curve[i].x;
-			if (d2 > cd * cd)
-				return false;
-			else
-				return true;
-		}
-	return false;
-}
-
-// Populates the envelope with a uniform distribution of attraction points
-vector<vec3> populate_envelope(const vector<vec2> &curve)
-{
-	float maxx = 0.0f;
-	float maxy = 0.0f;
-	float miny = 100.0f;
-	for (vec2 p : curve)
-	{
-		if (maxx < p.x)
-			maxx = p.x;
-		if (maxy < p.y)
-			maxy = p.y;
-		if (miny > p.y)
-			miny = p.y;
-	}
-	uniform_real_distribution<float> dist_xz(-maxx, maxx);
-	uniform_real_distribution<float> dist_y(miny, maxy);
-
-	vector<vec3> points;
-	vec3 point;
-	for (int i = 0; i < no_points; i++)
-	{
-		point = vec3(dist_xz(ran), dist_y(ran), dist_xz(ran));
-		if (inside_rotated_curve(point, curve))
-			points.push_back(point);
-		else
-		{
-			i--;
-			continue;
-		}
-	}
-	return points;
-}
-
-// Creates a structure representing the tree. The structure is stored in the provided root
-void create_node_tree(vector<vec3> points, node *root)
-{
-	while (points.size() > 0)
-	{
-		int size = root->size();
-		root->clear_attractions();
-		// Adds attraction vectors to the tree
-		for (const vec3 &p : points)
-		{
-			node *closest = root->closest_node(p);
-			// Only add attraction if point is within the radius of influence
-			if (length2(p - closest->pos) <= ri * ri)
-				closest->att_dir += normalize(p - closest->pos);
-		}
-		root->normalise_attractions();
-		root->colonise_nodes(dp);
-		// If no nodes are added add one above the last node
-		if (size == root->size())
-			if (root->get(size - 1)->pos.y > 8.0f)
-				return;
-			else
-				root->get(size - 1)->children.push_back(new node(root->get(size - 1)->pos + vec3(0.0f, dp, 0.0f)));
-		// Purge attraction points that are within kill distance
-		for (int i = 0; i < points.size(); i++)
-			if (root->is_closer_than(points[i], dk))
-			{
-				points.erase(points.begin() + i);
-				i--;
-			}
-	}
-}
-
-// Applies the effect of a tropism defined in this function
-vec3 apply_tropism(vec3 n, vec3 pos)
-{
-	switch (tropism)
-	{
-	case none:
-		return n;
-		break;
-	case gravity:
-		return normalize(n + vec3(0.0f, -0.6f, 0.0f));
-		break;
-	case attract:
-		if (pos.x + pos.z != 0)
-		{
-			vec3 core = vec3(0.0f, pos.y, 0.0f);
-			return normalize(normalize(core - pos) * 1.0f + n);
-		}
-		return n;
-		break;
-	case spin:
-		if (pos.x + pos.z != 0)
-		{
-			vec3 core = vec3(0.0f, pos.y, 0.0f);
-			vec3 perp = normalize(cross(vec3(0.0f, 1.0f, 0.0f), pos - core));
-			return normalize((perp * 1.0f) * dot(n, pos - core) + n);
-		}
-		return n;
-		break;
-	default:
-		return n;
-		break;
-	}
-}
-
-// Does a single iteration of the algorithm
-void create_tree_single_pass(vector<vec3> &points, node *root)
-{
-	if (points.size() == 0)
-		return;
-	int size = root->size();
-	root->clear_attractions();
-	// Adds attraction vectors to the tree
-	for (const vec3 &p : points)
-	{
-		node *closest = root->closest_node(p);
-		// Only add attraction if point is within the radius of influence
-		if (length2(p - closest->pos) <= ri * ri)
-		{
-			closest->att_dir += normalize(p - closest->pos);
-			if (use_debug)
-				att_segments.push_back(pair<vec3, vec3>(p, closest->pos));
-		}
-	}
-	root->normalise_attractions();
-	if (use_debug)
-		for (int i = 0; i < root->size(); i++)
-			if (root->get(i)->att_dir != vec3(0.0))
-				next_branch_segments.push_back(pair<vec3, vec3>(root->get(i)->pos, root->get(i)->pos + root->get(i)->att_dir * dp));
-	root->colonise_nodes(dp);
-	// If no nodes are added add one above the last node
-	static bool found_points_yet = false;
-	if (size == root->size())
-		if (root->get(size - 1)->pos.y > envelope_curve[0].y)
-			finished = true;
-		else
-			if (!found_points_yet)
-				root->get(size - 1)->children.push_back(new node(root->get(size - 1)->pos + vec3(0.0f, dp, 0.0f)));
-			else
-				finished = true;
-	else
-		found_points_yet = true;
-	// Purge attraction points that are within kill distance
-	for (int i = 0; i < points.size(); i++)
-		if (root->is_closer_than(points[i], dk))
-		{
-			points.erase(points.begin() + i);
-			i--;
-		}
-}
-
-// Creates cylinder meshes for given segments
-void create_meshes(const vector<pair<vec3, vec3>> &seg, vector<mesh> &v)
-{
-	for (pair<vec3, vec3> p : seg)
-	{
-		bool exists = false;
-		for (mesh &m : v)
-			if (m.get_transform().position == (p.first + p.second) / 2.0f)
-				exists = true;
-		if (exists)
-			continue;
-		v.push_back(mesh(geometry_builder().create_box()));
-		float l = length(p.first - p.second);
-		if (l != 0.0f)
-		{
-			vec3 up = vec3(normalize(p.second - p.first));
-			vec3 forward;
-			if (dot(up, vec3(1.0f, 0.0f, 0.0f)) < 1.0f)
-				forward = vec3(normalize(cross(up, vec3(1.0f, 0.0f, 0.0f))));
-			else
-				forward = vec3(normalize(cross(up, vec3(0.0f, 0.0f, 1.0f))));
-			v[v.size() - 1].get_transform().orientation = quatLookAt(forward, up);
-			v[v.size() - 1].get_transform().scale = vec3(0.03f, l, 0.03f);
-		}
-		else
-			v[v.size() - 1].get_transform().scale = vec3(0.03f, 0.03f, 0.03f);
-		v[v.size() - 1].get_transform().position = (p.first + p.second) / 2.0f;
-	}
-}
-
 // Uses default envelope to generate attraction points
 void prep_for_generating()
 {
-	points = populate_envelope(envelope_curve);
-	for (const vec3 &v : points)
-	{
-		//attraction_points.push_back(mesh(geometry(geometry_builder().create_sphere(10, 10, vec3(ri)))));
-		attraction_points.push_back(mesh(geometry(geometry_builder().create_box(vec3(0.05f)))));
-		attraction_points[attraction_points.size() - 1].get_transform().position = vec3(v);
-	}
-	// create root for the tree
-	root = new node(vec3(0.0f));
+	params.envelope_curve = envelope_curve;
+	// The points are shown once the first snapshot arrives
+	worker.start(params, 0);
+	// The first pass is grown straight away
+	worker.step();
 }
 
 // Handles the controls except for camera movement
@@ -606,11 +302,9 @@ void controls(const float &dt)
 
 			// Handle envelope drawing stuff
 			envelope_curve.clear();
-			envelope_segments.clear();
-			envelope.clear();
 			envelope_curve.push_back(vec2(0.2f, 8.0f));
 			envelope_segments = curve_to_segments(envelope_curve);
-			create_meshes(envelope_segments, envelope);
+			envelope.set(segments_mesh(envelope_segments, 0.03f));
 
 			cd = 0.2f;
 		}
@@ -623,10 +317,8 @@ void controls(const float &dt)
 		{
 			envelope_curve.push_back(envelope_curve[envelope_curve.size() - 1] + vec2(0.5f, -0.5f));
 			// Handle envelope drawing stuff
-			envelope_segments.clear();
-			envelope.clear();
 			envelope_segments = curve_to_segments(envelope_curve);
-			create_meshes(envelope_segments, envelope);
+			envelope.set(segments_mesh(envelope_segments, 0.03f));
 			cd = 0.2f;
 		}
 		// 1 to finish making curve
@@ -646,19 +338,15 @@ void controls(const float &dt)
 					break;
 				envelope_curve[envelope_curve.size() - 1] -= vec2(1.0f * dt, 0.0f);
 				// Handle envelope drawing stuff
-				envelope_segments.clear();
-				envelope.clear();
 				envelope_segments = curve_to_segments(envelope_curve);
-				create_meshes(envelope_segments, envelope);
+				envelope.set(segments_mesh(envelope_segments, 0.03f));
 			}
 			if (glfwGetKey(renderer::get_window(), GLFW_KEY_RIGHT))
 			{
 				envelope_curve[envelope_curve.size() - 1] += vec2(1.0f * dt, 0.0f);
 				// Handle envelope drawing stuff
-				envelope_segments.clear();
-				envelope.clear();
 				envelope_segments = curve_to_segments(envelope_curve);
-				create_meshes(envelope_segments, envelope);
+				envelope.set(segments_mesh(envelope_segments, 0.03f));
 			}
 			if (glfwGetKey(renderer::get_window(), GLFW_KEY_UP))
 			{
@@ -666,19 +354,15 @@ void controls(const float &dt)
 					break;
 				envelope_curve[envelope_curve.size() - 1] += vec2(0.0f, 1.0f * dt);
 				// Handle envelope drawing stuff
-				envelope_segments.clear();
-				envelope.clear();
 				envelope_segments = curve_to_segments(envelope_curve);
-				create_meshes(envelope_segments, envelope);
+				envelope.set(segments_mesh(envelope_segments, 0.03f));
 			}
 			if (glfwGetKey(renderer::get_window(), GLFW_KEY_DOWN))
 			{
 				envelope_curve[envelope_curve.size() - 1] -= vec2(0.0f, 1.0f * dt);
 				// Handle envelope drawing stuff
-				envelope_segments.clear();
-				envelope.clear();
 				envelope_segments = curve_to_segments(envelope_curve);
-				create_meshes(envelope_segments, envelope);
+				envelope.set(segments_mesh(envelope_segments, 0.03f));
 			}
 		}
 	}
@@ -686,38 +370,73 @@ void controls(const float &dt)
 	case gen_tree:
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_1) && cd <= 0.0f)
 		{
-			next_frame = true;
+			worker.step();
 			cd = 0.2f;
 		}
 
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_ENTER) && cd <= 0.0f)
 		{
 			no_wait = !no_wait;
+			worker.run(no_wait);
 			cd = 0.2f;
 		}
 
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_F1) && cd <= 0.0f)
 		{
 			use_debug = !use_debug;
+			worker.set_debug(use_debug);
+			cd = 0.2f;
+		}
+
+		// Profiling from the next pass on, written out when switched off
+		if (glfwGetKey(renderer::get_window(), GLFW_KEY_F2) && cd <= 0.0f)
+		{
+			if (!profiler::enabled())
+			{
+				profiler::enable(true);
+				cout << "Profiling" << endl;
+			}
+			else
+			{
+				profiler::enable(false);
+				if (profiler::write_trace("trace.json") && profiler::write_csv("profile.csv"))
+					cout << "Wrote the profile to trace.json and profile.csv" << endl;
+				else
+					cout << "Could not write the profile" << endl;
+			}
 			cd = 0.2f;
 		}
 
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_DELETE) && cd <= 0.0f)
 		{
-			cout << root->size() << endl;
-			root->reduce();
-			segments.clear();
-			tree.clear();
-			segments = root->get_segments();
-			create_meshes(segments, tree);
-			cout << root->size() << endl;
+			// The skeleton is rebuilt when the simplified snapshot arrives
+			worker.simplify();
 
 			cd = 0.2f;
 		}
 
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_HOME) && cd <= 0.0f)
 		{
-			tree = root->create_body();
+			body_lod = make_lod_chain(worker.snapshot().nodes, 10);
+			// Keeps the buffers of the levels made before
+			body_levels.resize(body_lod.levels.size());
+			for (int i = 0; i < body_lod.levels.size(); i++)
+				body_levels[i].set(body_lod.levels[i]);
+			show_body = true;
+
+			cd = 0.2f;
+		}
+
+		// Export the tree body
+		if (glfwGetKey(renderer::get_window(), GLFW_KEY_END) && cd <= 0.0f)
+		{
+			const node_tree &nodes = worker.snapshot().nodes;
+			flat_tree flat(nodes, nodes.pipe_radii());
+			body_chunks chunks(vector<tree_view>{ flat.view() }, 10);
+			if (export_glb("tree.glb", chunks.count(), [&chunks](int c, mesh_data &m) { chunks.fill(c, m); }))
+				cout << "Exported the tree body to tree.glb" << endl;
+			else
+				cout << "Could not export the tree body" << endl;
 
 			cd = 0.2f;
 		}
@@ -731,7 +450,7 @@ bool load_content()
 	// Set here to show default when choosing default or custom
 	envelope_curve = default_envelope_curve();
 	envelope_segments = curve_to_segments(envelope_curve);
-	create_meshes(envelope_segments, envelope);
+	envelope.set(segments_mesh(envelope_segments, 0.03f));
 	// Screen quad
 	{
 		vector<vec3> positions{ vec3(-1.0f, -1.0f, 0.0f), vec3(1.0f, -1.0f, 0.0f), vec3(-1.0f, 1.0f, 0.0f),	vec3(1.0f, 1.0f, 0.0f) };
@@ -790,6 +509,7 @@ bool load_content()
 
 bool update(float delta_time)
 {
+	scoped_timer timer("update");
 	controls(delta_time);
 
 	switch (stage)
@@ -799,44 +519,34 @@ bool update(float delta_time)
 	case define_crown:
 		break;
 	case gen_tree:
-		if ((!finished && next_frame) || no_wait)
+		if (worker.update())
 		{
-			if (tropism == wind)
-			{
-				for (vec3 &p : points)
-				{
-					p += vec3(0.04f, 0.0f, 0.0f);
-				}
-			}
-			next_frame = false;
-			att_segments.clear();
-			attractions.clear();
-			next_branch_segments.clear();
-			next_branches.clear();
-			//create_tree_single_pass(points, root);
-			// Clear meshes that no longer represent attraction points
-			for (int i = 0; i < attraction_points.size(); i++)
+			const tree_snapshot &snap = worker.snapshot();
+			// Simplifying or a new tree moves nodes that are already drawn, so the skeleton is made again
+			if (snap.layout != drawn_layout)
 			{
-				bool exists = false;
-				for (vec3 p : points)
-				{
-					if (p == attraction_points[i].get_transform().position)
-						exists = true;
-				}
-				if (exists == false)
-				{
-					attraction_points.erase(attraction_points.begin() + i);
-					i--;
-				}
+				if (snap.simplified > 0)
+					cout << "Simplified the skeleton, removed " << snap.simplified << " nodes, " << snap.nodes.size() << " left" << endl;
+				tree.set(segments_mesh(snap.nodes.get_segments(), 0.03f));
+				drawn_layout = snap.layout;
+				drawn_nodes = snap.nodes.ids();
+				show_body = false;
 			}
-			segments = root->get_segments();
-			create_meshes(segments, tree);
-			create_tree_single_pass(points, root);
-			if (use_debug)
+			// Add the new branches to the skeleton, which replaces the body as it no longer matches
+			mesh_data branches;
+			for (int id = drawn_nodes; id < snap.nodes.ids(); id++)
+				if (!snap.nodes.removed[id])
+					branches.add_box(snap.nodes.pos[snap.nodes.parent[id]], snap.nodes.pos[id], 0.03f);
+			if (drawn_nodes < snap.nodes.ids())
 			{
-				create_meshes(att_segments, attractions);
-				create_meshes(next_branch_segments, next_branches);
+				tree.append(branches);
+				drawn_nodes = snap.nodes.ids();
+				show_body = false;
 			}
+			attraction_points.set(snap.points);
+			// Debug segments are only recorded while debugging, so these are empty otherwise
+			attractions.set(segments_mesh(snap.att_segments, 0.03f));
+			next_branches.set(segments_mesh(snap.next_branch_segments, 0.03f));
 		}
 		break;
 	default:
@@ -851,6 +561,7 @@ bool update(float delta_time)
 
 bool render()
 {
+	scoped_timer timer("render");
 	mat4 MVP;
 	mat4 PV = calculatePV();
 
@@ -866,17 +577,12 @@ bool render()
 		MVP = PV * plane.get_transform().get_transform_matrix();
 		glUniformMatrix4fv(eff_lambert.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
 		glUniformMatrix3fv(eff_lambert.get_uniform_location("NM"), 1, GL_FALSE, value_ptr(plane.get_transform().get_normal_matrix()));
-		renderer::render(plane);
+		draw(plane);
 
 		// Render default envelope
 		renderer::bind(eff_blue);
-		for (mesh m : envelope)
-		{
-			mat4 MVP = PV * m.get_transform().get_transform_matrix();
-			// Set MVP matrix uniform
-			glUniformMatrix4fv(eff_blue.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
-			renderer::render(m);
-		}
+		glUniformMatrix4fv(eff_blue.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+		envelope.render();
 
 		// Render frame to screen with menu mask
 		renderer::set_render_target();
@@ -886,7 +592,7 @@ bool render()
 		glUniform1i(eff_mask.get_uniform_location("tex"), 0);
 		renderer::bind(masks["choose_envelope"], 1);
 		glUniform1i(eff_mask.get_uniform_location("alpha_map"), 1);
-		renderer::render(screen_quad);
+		draw(screen_quad);
 	}
 	break;
 
@@ -900,17 +606,12 @@ bool render()
 		MVP = PV * plane.get_transform().get_transform_matrix();
 		glUniformMatrix4fv(eff_lambert.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
 		glUniformMatrix3fv(eff_lambert.get_uniform_location("NM"), 1, GL_FALSE, value_ptr(plane.get_transform().get_normal_matrix()));
-		renderer::render(plane);
+		draw(plane);
 
 		// Render envelope
 		renderer::bind(eff_blue);
-		for (mesh m : envelope)
-		{
-			mat4 MVP = PV * m.get_transform().get_transform_matrix();
-			// Set MVP matrix uniform
-			glUniformMatrix4fv(eff_blue.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
-			renderer::render(m);
-		}
+		glUniformMatrix4fv(eff_blue.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+		envelope.render();
 
 		// Render frame to screen with menu mask
 		renderer::set_render_target();
@@ -920,7 +621,7 @@ bool render()
 		glUniform1i(eff_mask.get_uniform_location("tex"), 0);
 		renderer::bind(masks["define_envelope"], 1);
 		glUniform1i(eff_mask.get_uniform_location("alpha_map"), 1);
-		renderer::render(screen_quad);
+		draw(screen_quad);
 	}
 	break;
 
@@ -934,47 +635,32 @@ bool render()
 		MVP = PV * plane.get_transform().get_transform_matrix();
 		glUniformMatrix4fv(eff_lambert.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
 		glUniformMatrix3fv(eff_lambert.get_uniform_location("NM"), 1, GL_FALSE, value_ptr(plane.get_transform().get_normal_matrix()));
-		renderer::render(plane);
+		draw(plane);
 
 		glUniform3fv(eff_lambert.get_uniform_location("eyePosition"), 1, value_ptr(cam.get_position()));
-		for (mesh m : tree)
-		{
-			MVP = PV * m.get_transform().get_transform_matrix();
-			// Set MVP matrix uniform
-			glUniformMatrix4fv(eff_lambert.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
-			glUniformMatrix3fv(eff_lambert.get_uniform_location("NM"), 1, GL_FALSE, value_ptr(m.get_transform().get_normal_matrix()));
-			renderer::render(m);
-		}
+		// The tree is built in world space, so it needs no model transform
+		glUniformMatrix4fv(eff_lambert.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+		glUniformMatrix3fv(eff_lambert.get_uniform_location("NM"), 1, GL_FALSE, value_ptr(mat3(1.0f)));
+		if (show_body)
+			body_levels[select_lod(body_lod, length(cam.get_position() - worker.snapshot().nodes.pos[0]))].render();
+		else
+			tree.render();
 
 		// Render Attraction points, vectors and next branch position
 		if (use_debug)
 		{
 			renderer::bind(eff_green);
-			for (mesh m : attraction_points)
-			{
-				mat4 MVP = PV * m.get_transform().get_transform_matrix();
-				// Set MVP matrix uniform
-				glUniformMatrix4fv(eff_green.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
-				renderer::render(m);
-			}
+			glUniformMatrix4fv(eff_green.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+			glPointSize(4.0f);
+			attraction_points.render();
 
 			renderer::bind(eff_blue);
-			for (mesh m : attractions)
-			{
-				mat4 MVP = PV * m.get_transform().get_transform_matrix();
-				// Set MVP matrix uniform
-				glUniformMatrix4fv(eff_blue.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
-				renderer::render(m);
-			}
+			glUniformMatrix4fv(eff_blue.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+			attractions.render();
 
 			renderer::bind(eff_red);
-			for (mesh m : next_branches)
-			{
-				mat4 MVP = PV * m.get_transform().get_transform_matrix();
-				// Set MVP matrix uniform
-				glUniformMatrix4fv(eff_red.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(MVP));
-				renderer::render(m);
-			}
+			glUniformMatrix4fv(eff_red.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+			next_branches.render();
 		}
 
 		// Render frame to screen with menu mask
@@ -985,7 +671,7 @@ bool render()
 		glUniform1i(eff_mask.get_uniform_location("tex"), 0);
 		renderer::bind(masks["gen"], 1);
 		glUniform1i(eff_mask.get_uniform_location("alpha_map"), 1);
-		renderer::render(screen_quad);
+		draw(screen_quad);
 	}
 	break;
 	default:
@@ -1009,7 +695,7 @@ void main()
 
 	if (choice == "2")
 	{
-		no_points = 0;
+		params.no_points = 0;
 
 		// n of points
 		while (true)
@@ -1018,13 +704,13 @@ void main()
 			cin >> choice;
 			try
 			{
-				no_points = stoi(choice);
+				params.no_points = stoi(choice);
 			}
 			catch (const std::exception&)
 			{
 				cout << "Please enter a number with no other characters." << endl;
 			}
-			if (no_points <= 1 || no_points > 10000)
+			if (params.no_points <= 1 || params.no_points > 10000)
 				cout << "The number entered is outside of the acceptable range." << endl;
 			else
 				break;
@@ -1036,13 +722,13 @@ void main()
 			cin >> choice;
 			try
 			{
-				dp = stof(choice);
+				params.dp = stof(choice);
 			}
 			catch (const std::exception&)
 			{
 				cout << "Please enter a number with no other characters." << endl;
 			}
-			if (dp <= 0.01 || dp > 10)
+			if (params.dp <= 0.01 || params.dp > 10)
 				cout << "The number entered is outside of the acceptable range." << endl;
 			else
 				break;
@@ -1054,17 +740,17 @@ void main()
 			cin >> choice;
 			try
 			{
-				ri = stof(choice);
+				params.ri = stof(choice);
 			}
 			catch (const std::exception&)
 			{
 				cout << "Please enter a number with no other characters." << endl;
 			}
-			if (ri <= 1.5 || ri > 100)
+			if (params.ri <= 1.5 || params.ri > 100)
 				cout << "The number entered is outside of the acceptable range." << endl;
 			else
 			{
-				ri *= dp;
+				params.ri *= params.dp;
 				break;
 			}
 		}
@@ -1076,17 +762,39 @@ void main()
 			cin >> choice;
 			try
 			{
-				dk = stof(choice);
+				params.dk = stof(choice);
+			}
+			catch (const std::exception&)
+			{
+				cout << "Please enter a number with no other characters." << endl;
+			}
+			if (params.dk <= 1.5 || params.dk > 100 || params.ri < params.dk * params.dp)
+				cout << "The number entered is outside of the acceptable range." << endl;
+			else
+			{
+				params.dk *= params.dp;
+				break;
+			}
+		}
+		// Simplification error
+		while (true)
+		{
+			cout << "Please enter how far simplifying (DELETE) may move the skeleton as a multiplier for displacement distance (between 0 and 10):" << endl;
+			cin >> choice;
+			try
+			{
+				params.max_error = stof(choice);
 			}
 			catch (const std::exception&)
 			{
+				params.max_error = -1.0f;
 				cout << "Please enter a number with no other characters." << endl;
 			}
-			if (dk <= 1.5 || dk > 100 || ri < dk * dp)
+			if (params.max_error < 0 || params.max_error > 10)
 				cout << "The number entered is outside of the acceptable range." << endl;
 			else
 			{
-				dk *= dp;
+				params.max_error *= params.dp;
 				break;
 			}
 		}